@@ -7,6 +7,27 @@ extern "C" {
 // Opaque pointer to the RoaringGeoMapReader class
 typedef struct RoaringGeoMapReader RoaringGeoMapReader;
 
+// Work done by a single query and nanoseconds spent in each of its stages, see QueryStats.
+typedef struct RoaringGeoMapQueryStats {
+    uint64_t queryCells;
+    uint64_t filterProbes;
+    uint64_t rangesFound;
+    uint64_t ancestorsFound;
+    uint64_t blocksPlanned;
+    uint64_t cellIdEntriesScanned;
+    uint64_t bitmapsRead;
+    uint64_t bitmapsDecoded;
+    uint64_t unionCardinality;
+    uint64_t keyBlocksRead;
+    uint64_t bytesTouched;
+    uint64_t denormalizeNanos;
+    uint64_t filterNanos;
+    uint64_t planNanos;
+    uint64_t blockProbeNanos;
+    uint64_t unionNanos;
+    uint64_t keyFetchNanos;
+} RoaringGeoMapQueryStats;
+
 // Create a new RoaringGeoMapReader instance
 RoaringGeoMapReader* RoaringGeoMapReader_New(const char* filePath);
 
@@ -14,13 +35,28 @@ RoaringGeoMapReader* RoaringGeoMapReader_New(const char* filePath);
 void RoaringGeoMapReader_Delete(RoaringGeoMapReader* reader);
 
 // Perform the "Contains" query
-// The results will be a 2D array of data (serialized into a flat buffer).
-// Returns the size of the results or -1 in case of an error.
+// The results will be a 2D array of data (serialized into a flat buffer), resultSize holds the size of each of the
+// resultsSize keys. Both buffers are allocated with malloc and must be released with free.
+// Returns 0 on success or -1 in case of an error.
 int RoaringGeoMapReader_Contains(RoaringGeoMapReader* reader, const uint64_t* cellIds, uint64_t cellIdsCount, char** resultBuffer, uint64_t** resultSize, uint64_t* resultsSize);
 
+// Perform the "Contains" query and fill stats with the work done by the query and the time spent in each stage.
+// Same result layout as Contains.
+// Returns 0 on success or -1 in case of an error.
+int RoaringGeoMapReader_ContainsWithStats(RoaringGeoMapReader* reader, const uint64_t* cellIds, uint64_t cellIdsCount, char** resultBuffer, uint64_t** resultSize, uint64_t* resultsSize, RoaringGeoMapQueryStats* stats);
+
 // Perform the "Intersects" query
-// Similar semantics as Contains.
-int RoaringGeoMapReader_Intersects(RoaringGeoMapReader* reader, const uint64_t* cellIds, uint64_t cellIdsCount, char** resultBuffer, uint64_t* resultSize);
+// Same result layout as Contains.
+int RoaringGeoMapReader_Intersects(RoaringGeoMapReader* reader, const uint64_t* cellIds, uint64_t cellIdsCount, char** resultBuffer, uint64_t** resultSize, uint64_t* resultsSize);
+
+// Count the keys the "Contains" query would return without reading them.
+// Returns 0 on success or -1 in case of an error.
+int RoaringGeoMapReader_ContainsCount(RoaringGeoMapReader* reader, const uint64_t* cellIds, uint64_t cellIdsCount, uint64_t* resultCount);
+
+// Perform the "Contains" query returning the sorted ids of the matching keys instead of the keys. keyIds is allocated
+// with malloc and must be released with free.
+// Returns 0 on success or -1 in case of an error.
+int RoaringGeoMapReader_ContainsKeyIds(RoaringGeoMapReader* reader, const uint64_t* cellIds, uint64_t cellIdsCount, uint32_t** keyIds, uint64_t* keyIdsSize);
 
 #ifdef __cplusplus
 }
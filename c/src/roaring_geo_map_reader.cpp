@@ -2,6 +2,8 @@
 #include "RoaringGeoMapReader.h" // The actual C++ class header
 #include <vector>
 #include <cstring> // For memcpy
+#include <cstdlib> // For malloc
+#include <algorithm>
 
 extern "C" {
 
@@ -19,9 +21,32 @@ void RoaringGeoMapReader_Delete(RoaringGeoMapReader* reader) {
     delete reinterpret_cast<RoaringGeoMapReader*>(reader);
 }
 
+// Serializes results into a flat buffer of key bytes and an array of the size of each key. Buffers are allocated with
+// malloc so callers can release them with free. Keys are copied once, from the index into the result buffer.
+static void serializeResults(const QueryResults &result, char **resultBuffer, uint64_t **resultSize,
+                             uint64_t *resultsSize) {
+    size_t totalSize = 0;
+    *resultsSize = result.size();
+
+    *resultSize = static_cast<uint64_t *>(malloc(sizeof(uint64_t) * result.size()));
+    uint64_t *sizeWritePtr = *resultSize;
+    for (const auto &key: result) {
+        *sizeWritePtr = uint64_t(key.size());
+        sizeWritePtr++;
+        totalSize += key.size();
+    }
+
+    *resultBuffer = static_cast<char *>(malloc(totalSize));
+    char *writePtr = *resultBuffer;
+    for (const auto &key: result) {
+        memcpy(writePtr, key.data(), key.size());
+        writePtr += key.size();
+    }
+}
+
 // Wrapper for the Contains method
 int RoaringGeoMapReader_Contains(RoaringGeoMapReader* reader, const uint64_t* cellIds, uint64_t cellIdsCount, char** resultBuffer, uint64_t** resultSize, uint64_t* resultsSize) {
-    if (!reader || !cellIds || !resultBuffer || !resultSize) {
+    if (!reader || !cellIds || !resultBuffer || !resultSize || !resultsSize) {
         return -1; // Error: Invalid arguments
     }
 
@@ -34,26 +59,36 @@ int RoaringGeoMapReader_Contains(RoaringGeoMapReader* reader, const uint64_t* ce
 
         // Call the C++ method
         auto result = cppReader->Contains(cellUnion);
+        serializeResults(result, resultBuffer, resultSize, resultsSize);
+
+        return 0; // Success
+    } catch (...) {
+        return -1; // Error
+    }
+}
+
+// Wrapper for the Contains method collecting QueryStats
+int RoaringGeoMapReader_ContainsWithStats(RoaringGeoMapReader* reader, const uint64_t* cellIds, uint64_t cellIdsCount, char** resultBuffer, uint64_t** resultSize, uint64_t* resultsSize, RoaringGeoMapQueryStats* stats) {
+    if (!reader || !cellIds || !resultBuffer || !resultSize || !resultsSize || !stats) {
+        return -1; // Error: Invalid arguments
+    }
+
+    try {
+        auto cppReader = reinterpret_cast<RoaringGeoMapReader*>(reader);
+
+        S2CellUnion cellUnion;
+        cellUnion.Init(std::vector<uint64_t>(cellIds, cellIds + cellIdsCount));
 
-        // Serialize results into a flat buffer
-        size_t totalSize = 0;
-        *resultsSize = result.size();
-
-        *resultSize = new uint64_t[result.size()];
-        uint64_t* sizeWritePtr = *resultSize;
-        for (const auto& vec : result) {
-            *sizeWritePtr = uint64_t(vec.size());
-            sizeWritePtr++;
-            totalSize += vec.size();
-        }
-
-        *resultBuffer = new char[totalSize];
-        char* writePtr = *resultBuffer;
-        for (const auto& vec : result) {
-            memcpy(writePtr, vec.data(), vec.size());
-            writePtr += vec.size();
-        }
+        QueryStats queryStats;
+        auto result = cppReader->Contains(cellUnion, &queryStats);
+        serializeResults(result, resultBuffer, resultSize, resultsSize);
 
+        *stats = RoaringGeoMapQueryStats{
+                queryStats.queryCells, queryStats.filterProbes, queryStats.rangesFound, queryStats.ancestorsFound,
+                queryStats.blocksPlanned, queryStats.cellIdEntriesScanned, queryStats.bitmapsRead,
+                queryStats.bitmapsDecoded, queryStats.unionCardinality, queryStats.keyBlocksRead,
+                queryStats.bytesTouched, queryStats.denormalizeNanos, queryStats.filterNanos, queryStats.planNanos,
+                queryStats.blockProbeNanos, queryStats.unionNanos, queryStats.keyFetchNanos};
         return 0; // Success
     } catch (...) {
         return -1; // Error
@@ -61,8 +96,8 @@ int RoaringGeoMapReader_Contains(RoaringGeoMapReader* reader, const uint64_t* ce
 }
 
 // Wrapper for the Intersects method (similar to Contains)
-int RoaringGeoMapReader_Intersects(RoaringGeoMapReader* reader, const uint64_t* cellIds, uint64_t cellIdsCount, char** resultBuffer, uint64_t* resultSize) {
-    if (!reader || !cellIds || !resultBuffer || !resultSize) {
+int RoaringGeoMapReader_Intersects(RoaringGeoMapReader* reader, const uint64_t* cellIds, uint64_t cellIdsCount, char** resultBuffer, uint64_t** resultSize, uint64_t* resultsSize) {
+    if (!reader || !cellIds || !resultBuffer || !resultSize || !resultsSize) {
         return -1; // Error: Invalid arguments
     }
 
@@ -75,22 +110,49 @@ int RoaringGeoMapReader_Intersects(RoaringGeoMapReader* reader, const uint64_t*
 
         // Call the C++ method
         auto result = cppReader->Intersects(cellUnion);
+        serializeResults(result, resultBuffer, resultSize, resultsSize);
 
-        // Serialize results into a flat buffer
-        size_t totalSize = 0;
-        for (const auto& vec : result) {
-            totalSize += vec.size();
-        }
+        return 0; // Success
+    } catch (...) {
+        return -1; // Error
+    }
+}
+
+// Wrapper for the ContainsCount method
+int RoaringGeoMapReader_ContainsCount(RoaringGeoMapReader* reader, const uint64_t* cellIds, uint64_t cellIdsCount, uint64_t* resultCount) {
+    if (!reader || !cellIds || !resultCount) {
+        return -1; // Error: Invalid arguments
+    }
+
+    try {
+        auto cppReader = reinterpret_cast<RoaringGeoMapReader*>(reader);
 
-        *resultBuffer = new char[totalSize];
-        *resultSize = totalSize;
+        S2CellUnion cellUnion;
+        cellUnion.Init(std::vector<uint64_t>(cellIds, cellIds + cellIdsCount));
 
-        char* writePtr = *resultBuffer;
-        for (const auto& vec : result) {
-            memcpy(writePtr, vec.data(), vec.size());
-            writePtr += vec.size();
-        }
+        *resultCount = cppReader->ContainsCount(cellUnion);
+        return 0; // Success
+    } catch (...) {
+        return -1; // Error
+    }
+}
+
+// Wrapper for the ContainsKeyIds method
+int RoaringGeoMapReader_ContainsKeyIds(RoaringGeoMapReader* reader, const uint64_t* cellIds, uint64_t cellIdsCount, uint32_t** keyIds, uint64_t* keyIdsSize) {
+    if (!reader || !cellIds || !keyIds || !keyIdsSize) {
+        return -1; // Error: Invalid arguments
+    }
+
+    try {
+        auto cppReader = reinterpret_cast<RoaringGeoMapReader*>(reader);
+
+        S2CellUnion cellUnion;
+        cellUnion.Init(std::vector<uint64_t>(cellIds, cellIds + cellIdsCount));
 
+        auto result = cppReader->ContainsKeyIds(cellUnion);
+        *keyIdsSize = result.cardinality();
+        *keyIds = static_cast<uint32_t *>(malloc(sizeof(uint32_t) * std::max<uint64_t>(*keyIdsSize, 1)));
+        result.toUint32Array(*keyIds);
         return 0; // Success
     } catch (...) {
         return -1; // Error
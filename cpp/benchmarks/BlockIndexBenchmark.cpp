@@ -0,0 +1,83 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+#include "BlockIndexWriter.h"
+#include "BlockIndexTree.h"
+#include "VectorView.h"
+#include "io/FileWriteBuffer.h"
+#include "io/FileReadBuffer.h"
+
+// Compares block lookups through the block index tree against the binary search over the sorted block index, for
+// block indexes from a few thousand to tens of millions of blocks. Lookups are random so each one starts cold.
+
+const int LOOKUPS = 1000000;
+
+template<typename Search>
+void benchmarkLookups(const std::string &name, const std::vector<uint64_t> &lookups, Search search) {
+    uint64_t sink = 0;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (auto value: lookups) {
+        sink += search(value);
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    double nanoseconds = std::chrono::duration<double, std::nano>(end_time - start_time).count();
+    std::cout << "  " << name << ": " << nanoseconds / lookups.size() << " ns per lookup (checksum " << sink << ")\n";
+}
+
+int main() {
+    auto fileName = "block_index_benchmark_file.roaring";
+    std::mt19937_64 gen(42);
+
+    for (uint64_t blocks: {4096, 65536, 1048576, 16777216}) {
+        std::vector<uint64_t> values(blocks);
+        for (auto &value: values) {
+            value = gen();
+        }
+        std::sort(values.begin(), values.end());
+
+        uint64_t treePos;
+        {
+            FileWriteBuffer f(fileName, blocks * sizeof(uint64_t) * 2);
+            BlockIndexWriter<uint64_t> blockIndex;
+            BlockIndexTreeWriter blockIndexTree;
+            for (auto value: values) {
+                blockIndex.addValue(value);
+                blockIndexTree.addValue(value);
+            }
+            blockIndex.writeToFile(f);
+            treePos = f.offset();
+            blockIndexTree.writeToFile(f);
+            f.finalize();
+        }
+
+        FileReadBuffer f(fileName);
+        VectorView<uint64_t> blockIndex(f, 0, blocks);
+        BlockIndexTreeReader blockIndexTree(f, treePos, blockIndex);
+
+        std::vector<uint64_t> lookups(LOOKUPS);
+        for (auto &lookup: lookups) {
+            lookup = gen();
+        }
+        for (auto lookup: lookups) {
+            auto expected = std::lower_bound(blockIndex.begin(), blockIndex.end(), lookup) - blockIndex.begin();
+            if (blockIndexTree.lowerBound(lookup) != expected) {
+                std::cerr << "block index tree lookup of " << lookup << " does not match the binary search\n";
+                return 1;
+            }
+        }
+
+        std::cout << "\nBlock Index Bench Mark: [Blocks: " << blocks << "] [Tree size: " << blockIndexTree.sizeOf()
+                  << " bytes] [Lookups: " << LOOKUPS << "]\n";
+        benchmarkLookups("std::lower_bound over sorted block index", lookups, [&](uint64_t value) {
+            return std::lower_bound(blockIndex.begin(), blockIndex.end(), value) - blockIndex.begin();
+        });
+        benchmarkLookups("block index tree", lookups, [&](uint64_t value) {
+            return blockIndexTree.lowerBound(value);
+        });
+    }
+    std::remove(fileName);
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include <sys/resource.h>
+#include <roaring/memory.h>
+#include "RoaringGeoMapWriter.h"
+#include <s2/s2latlng.h>
+#include <s2/s2cell_id.h>
+#include <s2/s2cell_union.h>
+
+// Measures the time, peak memory and heap allocations of building an index of many small keys, by default 10 million
+// keys each covered by one or two cells between levels 12 and 20. Write allocations include generating the covers and
+// keys, allocations other libraries make directly with malloc, such as stdio buffers, are not counted. Usage:
+// RoaringGeoMapsBuildBenchmark [key count] [build threads] [build memory budget MB, 0 builds in memory]
+
+// Heap allocations made through operator new and by CRoaring, counted by the replacements and memory hooks below.
+std::atomic<uint64_t> allocationCount{0};
+std::atomic<uint64_t> allocationBytes{0};
+
+void countAllocation(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void *operator new(std::size_t size) {
+    countAllocation(size);
+    if (void *data = std::malloc(size == 0 ? 1 : size))
+        return data;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *data) noexcept {
+    std::free(data);
+}
+
+void operator delete(void *data, std::size_t) noexcept {
+    std::free(data);
+}
+
+// CRoaring allocates its containers with malloc rather than operator new, its memory hooks count them. A realloc counts
+// as an allocation of the new size.
+void *countingMalloc(std::size_t size) {
+    countAllocation(size);
+    return std::malloc(size);
+}
+
+void *countingRealloc(void *data, std::size_t size) {
+    countAllocation(size);
+    return std::realloc(data, size);
+}
+
+void *countingCalloc(std::size_t count, std::size_t size) {
+    countAllocation(count * size);
+    return std::calloc(count, size);
+}
+
+void *countingAlignedMalloc(std::size_t alignment, std::size_t size) {
+    countAllocation(size);
+    void *data = nullptr;
+    return posix_memalign(&data, alignment, size) == 0 ? data : nullptr;
+}
+
+// Peak resident set size of the process so far in megabytes, ru_maxrss is in kilobytes on Linux.
+double peakRssMegabytes() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+// Returns the cover of a random cell within the contiguous United States, and one of its neighbours half of the time.
+S2CellUnion generateRandomCover(std::mt19937 &gen) {
+    std::uniform_real_distribution<> lat_dist(24.396308, 49.384358);
+    std::uniform_real_distribution<> lng_dist(-125.0, -66.93457);
+    std::uniform_int_distribution<> level_dist(12, 20);
+    S2CellId cell = S2CellId(S2LatLng::FromDegrees(lat_dist(gen), lng_dist(gen))).parent(level_dist(gen));
+    std::vector<S2CellId> cells{cell};
+    if (gen() % 2 == 0)
+        cells.push_back(cell.next());
+    return S2CellUnion(std::move(cells));
+}
+
+int main(int argc, char **argv) {
+    auto fileName = "build_benchmark_file.roaring";
+    uint64_t keyCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    RoaringGeoMapWriterOptions options;
+    options.buildThreads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1;
+    options.buildMemoryBudget = (argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 0) * 1024 * 1024;
+
+    roaring_init_memory_hook({
+            .malloc = countingMalloc,
+            .realloc = countingRealloc,
+            .calloc = countingCalloc,
+            .free = [](void *data) { std::free(data); },
+            .aligned_malloc = countingAlignedMalloc,
+            .aligned_free = [](void *data) { std::free(data); },
+    });
+
+    std::mt19937 gen(42);
+    RoaringGeoMapWriter writer(3, options);
+    std::chrono::nanoseconds writeTime{0};
+    uint64_t writeAllocations = allocationCount;
+    uint64_t writeAllocationBytes = allocationBytes;
+    for (uint64_t i = 0; i < keyCount; ++i) {
+        auto cover = generateRandomCover(gen);
+        auto key = "key-" + std::to_string(i);
+        auto start_time = std::chrono::high_resolution_clock::now();
+        writer.write(cover, key);
+        writeTime += std::chrono::high_resolution_clock::now() - start_time;
+    }
+    double writeRss = peakRssMegabytes();
+    writeAllocations = allocationCount - writeAllocations;
+    writeAllocationBytes = allocationBytes - writeAllocationBytes;
+
+    uint64_t buildAllocations = allocationCount;
+    uint64_t buildAllocationBytes = allocationBytes;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    writer.build(fileName);
+    auto buildTime = std::chrono::high_resolution_clock::now() - start_time;
+    buildAllocations = allocationCount - buildAllocations;
+    buildAllocationBytes = allocationBytes - buildAllocationBytes;
+
+    FILE *file = std::fopen(fileName, "rb");
+    std::fseek(file, 0, SEEK_END);
+    long fileSize = std::ftell(file);
+    std::fclose(file);
+
+    std::cout << "\nBuild Bench Mark: [Keys: " << keyCount << "] [Build Threads: " << options.buildThreads
+              << "] [Memory Budget: " << options.buildMemoryBudget / (1024 * 1024) << " MB]\n";
+    std::cout << "----------------------------------------------------------\n";
+    std::cout << "Write: " << std::chrono::duration<double>(writeTime).count() << " seconds, peak RSS "
+              << writeRss << " MB, " << writeAllocations << " allocations of "
+              << writeAllocationBytes / (1024.0 * 1024.0) << " MB\n";
+    std::cout << "Build: " << std::chrono::duration<double>(buildTime).count() << " seconds, peak RSS "
+              << peakRssMegabytes() << " MB, " << buildAllocations << " allocations of "
+              << buildAllocationBytes / (1024.0 * 1024.0) << " MB\n";
+    std::cout << "File size: " << fileSize / (1024.0 * 1024.0) << " MB\n";
+    std::remove(fileName);
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <random>
+#include "RoaringGeoMapWriter.h"
+#include "RoaringGeoMapReader.h"
+#include "s2/s2earth.h"
+#include <s2/s2latlng.h>
+#include <s2/s2cell_id.h>
+#include <s2/s2region_coverer.h>
+#include <s2/s2cap.h>
+
+// Measures query throughput and latency of a single RoaringGeoMapReader shared by 1..N threads.
+
+// Function to generate a cover of a circle with a random center within the contiguous United States
+S2CellUnion generateRandomCover(std::mt19937 &gen, double radius_meters) {
+    std::uniform_real_distribution<> lat_dist(24.396308, 49.384358);
+    std::uniform_real_distribution<> lng_dist(-125.0, -66.93457);
+    S2LatLng center = S2LatLng::FromDegrees(lat_dist(gen), lng_dist(gen));
+    S2Cap circle = S2Cap::FromCenterHeight(center.ToPoint(), S2Earth::MetersToRadians(radius_meters));
+
+    S2RegionCoverer::Options options;
+    options.set_max_cells(30);
+    S2RegionCoverer coverer(options);
+    return coverer.GetCovering(circle);
+}
+
+// Runs numQueries queries on each of threads threads against reader and prints QPS, mean and p99 latency.
+void benchmarkSharedReader(const RoaringGeoMapReader &reader, const std::vector<S2CellUnion> &queries, int threads,
+                           int numQueries) {
+    std::vector<std::vector<long long>> threadTimes(threads);
+    std::atomic<bool> start = false;
+    std::atomic<size_t> resultCount = 0;
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            QueryContext context;
+            auto &times = threadTimes[t];
+            times.reserve(numQueries);
+            while (!start.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            for (int i = 0; i < numQueries; ++i) {
+                const auto &query = queries[(t * numQueries + i) % queries.size()];
+                auto start_time = std::chrono::high_resolution_clock::now();
+                auto count = reader.Contains(query, context).size();
+                auto end_time = std::chrono::high_resolution_clock::now();
+                resultCount.fetch_add(count, std::memory_order_relaxed);
+                times.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count());
+            }
+        });
+    }
+
+    auto start_wall = std::chrono::high_resolution_clock::now();
+    start.store(true, std::memory_order_release);
+    for (auto &worker: workers)
+        worker.join();
+    auto end_wall = std::chrono::high_resolution_clock::now();
+
+    std::vector<long long> execution_times;
+    for (const auto &times: threadTimes)
+        execution_times.insert(execution_times.end(), times.begin(), times.end());
+    long long sum = 0;
+    for (const auto &time: execution_times)
+        sum += time;
+    double mean = static_cast<double>(sum) / execution_times.size();
+    std::sort(execution_times.begin(), execution_times.end());
+    double p99 = execution_times[static_cast<int>(execution_times.size() * 0.99)];
+    double seconds = std::chrono::duration<double>(end_wall - start_wall).count();
+
+    std::cout << "[Threads: " << threads << "] QPS: " << execution_times.size() / seconds << ", mean: " << mean
+              << " microseconds, p99: " << p99 << " microseconds\n";
+}
+
+int main() {
+    auto fileName = "concurrent_benchmark_file.roaring";
+    int circleCount = 50000;
+    double radiusMeters = 1000;
+    int queriesPerThread = 2000;
+
+    std::mt19937 gen(42);
+    RoaringGeoMapWriter writer(3);
+    std::vector<S2CellUnion> covers;
+    for (int i = 0; i < circleCount; ++i) {
+        covers.push_back(generateRandomCover(gen, radiusMeters));
+        writer.write(covers.back(), "circle-" + std::to_string(i));
+    }
+    writer.build(fileName);
+
+    RoaringGeoMapReader reader(fileName);
+
+    std::cout << "\nConcurrent Bench Mark: [Circles: " << circleCount << "] [Radius: " << radiusMeters << "m]\n";
+    std::cout << "----------------------------------------------------------\n";
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        benchmarkSharedReader(reader, covers, threads, queriesPerThread);
+    }
+    if ((maxThreads & (maxThreads - 1)) != 0)
+        benchmarkSharedReader(reader, covers, maxThreads, queriesPerThread);
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <span>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include "ByteColumnWriter.h"
+#include "ColumnStreamWriter.h"
+
+// Measures the time and heap allocations of writing the key column of many small keys, by default 1 million, as build
+// writes it: with ByteColumnWriter over views of the key arena when building in memory, and with ColumnStreamWriter
+// over per block buffers when the keys are spilled. Usage:
+// RoaringGeoMapsKeyColumnBenchmark [key count]
+
+// Heap allocations made through operator new, counted by the replacements below.
+std::atomic<uint64_t> allocationCount{0};
+
+void *operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *data = std::malloc(size == 0 ? 1 : size))
+        return data;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *data) noexcept {
+    std::free(data);
+}
+
+void operator delete(void *data, std::size_t) noexcept {
+    std::free(data);
+}
+
+const uint64_t BLOCK_ENTRIES = 1024;
+
+void printResult(const std::string &name, std::chrono::nanoseconds time, uint64_t allocations) {
+    std::cout << name << ": " << std::chrono::duration<double>(time).count() << " seconds, " << allocations
+              << " allocations\n";
+}
+
+int main(int argc, char **argv) {
+    auto fileName = "key_column_benchmark_file.bin";
+    uint64_t keyCount = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    std::vector<char> keyArena;
+    std::vector<uint64_t> keyEnds;
+    for (uint64_t i = 0; i < keyCount; ++i) {
+        auto key = "key-" + std::to_string(i);
+        keyArena.insert(keyArena.end(), key.begin(), key.end());
+        keyEnds.push_back(keyArena.size());
+    }
+    std::span<const char> keys(keyArena);
+    auto keyAt = [&](uint64_t i) {
+        uint64_t keyStart = i == 0 ? 0 : keyEnds[i - 1];
+        return keys.subspan(keyStart, keyEnds[i] - keyStart);
+    };
+
+    std::cout << "\nKey Column Bench Mark: [Keys: " << keyCount << "]\n";
+    std::cout << "----------------------------------------------------------\n";
+    {
+        FileWriteBuffer f(fileName);
+        uint64_t allocations = allocationCount;
+        auto start_time = std::chrono::high_resolution_clock::now();
+        ByteColumnWriter keyColumn(BLOCK_ENTRIES);
+        for (uint64_t i = 0; i < keyCount; ++i)
+            keyColumn.addBytes(keyAt(i));
+        keyColumn.writeToFile(f);
+        f.finalize();
+        printResult("ByteColumnWriter", std::chrono::high_resolution_clock::now() - start_time,
+                    allocationCount - allocations);
+    }
+    {
+        FileWriteBuffer f(fileName);
+        uint64_t allocations = allocationCount;
+        auto start_time = std::chrono::high_resolution_clock::now();
+        ColumnStreamWriter<BytesBlockWriter, std::span<const char>> keyColumn(f, BLOCK_ENTRIES, keyCount);
+        std::vector<std::vector<char>> blockKeys(BLOCK_ENTRIES);
+        size_t blockKeyCount = 0;
+        for (uint64_t i = 0; i < keyCount; ++i) {
+            auto key = keyAt(i);
+            auto &blockKey = blockKeys[blockKeyCount++];
+            blockKey.assign(key.begin(), key.end());
+            if (keyColumn.addValue(blockKey, key.size()))
+                blockKeyCount = 0;
+        }
+        keyColumn.finish();
+        f.finalize();
+        printResult("ColumnStreamWriter", std::chrono::high_resolution_clock::now() - start_time,
+                    allocationCount - allocations);
+    }
+    std::remove(fileName);
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstring>
+#include "SearchKernels.h"
+#include "VectorView.h"
+
+// Compares the search kernels against a std::lower_bound per query value over a VectorView, the search CellId blocks
+// used before the kernels, on a single block of BLOCK_ENTRIES sorted cell ids.
+
+const uint32_t BLOCK_ENTRIES = 1024;
+const int ITERATIONS = 50000;
+// Batches are cycled through so branches of a search do not repeat from one iteration to the next.
+const size_t BATCHES = 1024;
+
+// Lays the values out as they are in the file, little endian and not necessarily 8 byte aligned.
+std::vector<char> writeBlock(const std::vector<uint64_t> &values, size_t misalignment) {
+    std::vector<char> block(misalignment + values.size() * sizeof(uint64_t));
+    for (size_t i = 0; i < values.size(); ++i) {
+        uint64_t value = littleEndian(values[i]);
+        std::memcpy(block.data() + misalignment + i * sizeof(uint64_t), &value, sizeof(uint64_t));
+    }
+    return block;
+}
+
+// Returns batchSize sorted query values, about half of which are in the block.
+std::vector<uint64_t> generateQueryValues(std::mt19937_64 &gen, const std::vector<uint64_t> &values, size_t batchSize) {
+    std::vector<uint64_t> queries;
+    std::uniform_int_distribution<size_t> index(0, values.size() - 1);
+    for (size_t i = 0; i < batchSize; ++i) {
+        queries.push_back(i % 2 == 0 ? values[index(gen)] : values[index(gen)] + 1);
+    }
+    std::sort(queries.begin(), queries.end());
+    return queries;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> generateQueryRanges(std::mt19937_64 &gen, const std::vector<uint64_t> &values,
+                                                              size_t batchSize) {
+    auto bounds = generateQueryValues(gen, values, batchSize * 2);
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    for (size_t i = 0; i + 1 < bounds.size(); i += 2) {
+        ranges.emplace_back(bounds[i], bounds[i + 1]);
+    }
+    return ranges;
+}
+
+template<typename Search>
+void benchmarkSearch(const std::string &name, size_t batchSize, Search search) {
+    size_t sink = 0;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        sink += search(i % BATCHES);
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    double nanoseconds = std::chrono::duration<double, std::nano>(end_time - start_time).count();
+    std::cout << "  " << name << ": " << nanoseconds / (double(ITERATIONS) * batchSize) << " ns per query ("
+              << sink / ITERATIONS << " matches)\n";
+}
+
+int main() {
+    std::mt19937_64 gen(42);
+    std::vector<uint64_t> values(BLOCK_ENTRIES);
+    for (auto &value: values) {
+        value = gen() | 1; // S2 cell ids are odd.
+    }
+    std::sort(values.begin(), values.end());
+    auto block = writeBlock(values, 4);
+    const char *data = block.data() + 4;
+
+    std::vector<SearchKernel> kernels;
+    for (auto kernel: {SearchKernel::Scalar, SearchKernel::SSE42, SearchKernel::AVX2, SearchKernel::AVX512}) {
+        if (SearchKernels::supported(kernel))
+            kernels.push_back(kernel);
+    }
+    std::cout << "Search kernel selected at runtime: " << SearchKernels::name(SearchKernels::best().kernel()) << "\n";
+
+    for (size_t batchSize: {1, 8, 64, 256}) {
+        std::vector<std::vector<uint64_t>> queryValues;
+        for (size_t i = 0; i < BATCHES; ++i)
+            queryValues.push_back(generateQueryValues(gen, values, batchSize));
+        std::vector<uint32_t> indexes;
+
+        std::cout << "\nValue lookup [Block entries: " << BLOCK_ENTRIES << "] [Batch: " << batchSize << "]\n";
+        benchmarkSearch("std::lower_bound over VectorView", batchSize, [&](size_t batch) {
+            indexes.clear();
+            VectorView<uint64_t>::Iterator begin(data);
+            VectorView<uint64_t>::Iterator end(data + BLOCK_ENTRIES * sizeof(uint64_t));
+            for (auto value: queryValues[batch]) {
+                auto it = std::lower_bound(begin, end, value);
+                if (it != end && *it == value)
+                    indexes.emplace_back(std::distance(begin, it));
+            }
+            return indexes.size();
+        });
+        for (auto kernel: kernels) {
+            const auto &search = SearchKernels::get(kernel);
+            benchmarkSearch(SearchKernels::name(kernel), batchSize, [&](size_t batch) {
+                search.findValues(data, BLOCK_ENTRIES, queryValues[batch], indexes);
+                return indexes.size();
+            });
+        }
+
+        std::vector<std::vector<std::pair<uint64_t, uint64_t>>> queryRanges;
+        for (size_t i = 0; i < BATCHES; ++i)
+            queryRanges.push_back(generateQueryRanges(gen, values, batchSize));
+        std::vector<std::pair<uint32_t, uint32_t>> indexRanges;
+
+        std::cout << "Range bounds [Block entries: " << BLOCK_ENTRIES << "] [Batch: " << batchSize << "]\n";
+        benchmarkSearch("std::lower_bound over VectorView", batchSize, [&](size_t batch) {
+            indexRanges.clear();
+            VectorView<uint64_t>::Iterator begin(data);
+            VectorView<uint64_t>::Iterator end(data + BLOCK_ENTRIES * sizeof(uint64_t));
+            for (const auto &range: queryRanges[batch]) {
+                auto lowerIt = std::lower_bound(begin, end, range.first);
+                auto upperIt = std::upper_bound(lowerIt, end, range.second);
+                if (lowerIt < upperIt)
+                    indexRanges.emplace_back(std::distance(begin, lowerIt), std::distance(begin, upperIt) - 1);
+            }
+            return indexRanges.size();
+        });
+        for (auto kernel: kernels) {
+            const auto &search = SearchKernels::get(kernel);
+            benchmarkSearch(SearchKernels::name(kernel), batchSize, [&](size_t batch) {
+                search.findRanges(data, BLOCK_ENTRIES, queryRanges[batch], indexRanges);
+                return indexRanges.size();
+            });
+        }
+    }
+    return 0;
+}
@@ -3,6 +3,8 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <functional>
+#include <map>
 #include "RoaringGeoMapWriter.h"
 #include "RoaringGeoMapReader.h"
 #include "s2/s2earth.h"
@@ -100,8 +102,10 @@ void benchmarkWrite(RoaringGeoMapWriter& writer, const std::vector<std::vector<S
     std::cout << "99th percentile (p99) write execution time: " << p99 << " microseconds\n";
 }
 
-// Function to benchmark querying the index with circles
-void benchmarkQueryExecution(RoaringGeoMapReader& reader, int numQueries, const std::vector<std::vector<S2CellId>>& indexedCellIds) {
+// Function to benchmark querying the index with circles, query runs the reader method being measured and returns the
+// number of keys found.
+void benchmarkQueryExecution(const std::string& queryName, int numQueries, const std::vector<std::vector<S2CellId>>& indexedCellIds,
+                             const std::function<size_t(const S2CellUnion&)>& query) {
     // Store query execution times
     std::vector<long long> execution_times;
 
@@ -113,7 +117,7 @@ void benchmarkQueryExecution(RoaringGeoMapReader& reader, int numQueries, const
 
         // Measure the query execution time
         auto start_time = std::chrono::high_resolution_clock::now();
-        auto queryResults = reader.Contains(cellUnion);
+        auto resultCount = query(cellUnion);
         auto end_time = std::chrono::high_resolution_clock::now();
 
         auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
@@ -131,8 +135,78 @@ void benchmarkQueryExecution(RoaringGeoMapReader& reader, int numQueries, const
     std::sort(execution_times.begin(), execution_times.end());
     double p99 = execution_times[static_cast<int>(execution_times.size() * 0.99)];
 
-    std::cout << "Mean query execution time: " << mean << " microseconds\n";
-    std::cout << "99th percentile (p99) query execution time: " << p99 << " microseconds\n";
+    std::cout << "Mean " << queryName << " query execution time: " << mean << " microseconds\n";
+    std::cout << "99th percentile (p99) " << queryName << " query execution time: " << p99 << " microseconds\n";
+}
+
+// Function to benchmark querying the index with batches of circles through ContainsBatch
+void benchmarkBatchQueryExecution(RoaringGeoMapReader& reader, int numQueries, int batchSize, const std::vector<std::vector<S2CellId>>& indexedCellIds) {
+    // Store batch execution times
+    std::vector<long long> execution_times;
+
+    for (int i = 0; i < numQueries; i += batchSize) {
+        std::vector<S2CellUnion> batch;
+        for (int j = i; j < std::min(i + batchSize, numQueries); ++j) {
+            S2CellUnion cellUnion;
+            cellUnion.Init(indexedCellIds[j % indexedCellIds.size()]);
+            batch.push_back(std::move(cellUnion));
+        }
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        auto queryResults = reader.ContainsBatch(batch);
+        auto end_time = std::chrono::high_resolution_clock::now();
+
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+        execution_times.push_back(duration);
+    }
+
+    long long sum = 0;
+    for (const auto& time : execution_times) {
+        sum += time;
+    }
+    double mean = static_cast<double>(sum) / execution_times.size();
+
+    std::cout << "Mean ContainsBatch execution time: " << mean << " microseconds per " << batchSize << " queries, "
+              << static_cast<double>(sum) / numQueries << " microseconds per query\n";
+}
+
+// Function to benchmark Contains for large query covers, e.g. country or state sized polygons, where planning the blocks
+// to read dominates the query.
+void benchmarkLargeCoverQueryExecution(RoaringGeoMapReader& reader, int numQueries, int maxCells, double radius_meters) {
+    std::vector<long long> execution_times;
+    size_t totalCells = 0;
+    QueryContext context;
+    std::map<std::string, int> strategies;
+
+    for (int i = 0; i < numQueries; ++i) {
+        S2Cap circle = generateRandomCircle(radius_meters);
+        S2RegionCoverer::Options options;
+        options.set_max_cells(maxCells);
+        options.set_max_level(S2CellId::kMaxLevel);
+        S2RegionCoverer coverer(options);
+        S2CellUnion cellUnion = coverer.GetCovering(circle);
+        totalCells += cellUnion.size();
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        auto resultCount = reader.Contains(cellUnion, context).size();
+        auto end_time = std::chrono::high_resolution_clock::now();
+
+        execution_times.push_back(std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count());
+        strategies[queryStrategyName(context.plan().strategy)]++;
+    }
+
+    long long sum = 0;
+    for (const auto& time : execution_times) {
+        sum += time;
+    }
+    double mean = static_cast<double>(sum) / execution_times.size();
+    std::sort(execution_times.begin(), execution_times.end());
+
+    std::cout << "Mean Contains execution time for covers of " << totalCells / numQueries << " cells: " << mean
+              << " microseconds, max " << execution_times.back() << " microseconds, strategies:";
+    for (const auto &[strategy, count]: strategies)
+        std::cout << " " << strategy << " x" << count;
+    std::cout << "\n";
 }
 
 int main() {
@@ -174,10 +248,48 @@ int main() {
             std::cout << "Init benchmark completed in " << init_duration << " ms.\n";
 
             auto start_query = std::chrono::high_resolution_clock::now();
-            benchmarkQueryExecution(reader, 2000, indexedCellIds);
+            benchmarkQueryExecution("Contains", 2000, indexedCellIds,
+                                    [&](const S2CellUnion& cellUnion) { return reader.Contains(cellUnion).size(); });
             auto end_query = std::chrono::high_resolution_clock::now();
             auto query_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_query - start_query).count();
             std::cout << "Query benchmark completed in " << query_duration << " ms.\n";
+
+            // The same queries reusing one context, steady state queries do not allocate their plan or results.
+            QueryContext context;
+            benchmarkQueryExecution("Contains (reused context)", 2000, indexedCellIds,
+                                    [&](const S2CellUnion& cellUnion) { return reader.Contains(cellUnion, context).size(); });
+
+            benchmarkBatchQueryExecution(reader, 2000, 64, indexedCellIds);
+
+            auto start_intersects = std::chrono::high_resolution_clock::now();
+            benchmarkQueryExecution("Intersects", 2000, indexedCellIds,
+                                    [&](const S2CellUnion& cellUnion) { return reader.Intersects(cellUnion).size(); });
+            auto end_intersects = std::chrono::high_resolution_clock::now();
+            auto intersects_duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_intersects - start_intersects).count();
+            std::cout << "Intersects benchmark completed in " << intersects_duration << " ms.\n";
+
+            // The same circles indexed with the Elias-Fano cell filter, probed on cell ids without string conversions.
+            auto eliasFanoFileName = "benchmark_file_elias_fano.roaring";
+            RoaringGeoMapWriterOptions eliasFanoOptions;
+            eliasFanoOptions.cellFilterType = CellFilterType::EliasFano;
+            RoaringGeoMapWriter eliasFanoWriter(3, eliasFanoOptions);
+            for (int i = 0; i < indexedCellIds.size(); ++i) {
+                S2CellUnion cellUnion;
+                cellUnion.Init(indexedCellIds[i]);
+                eliasFanoWriter.write(cellUnion, "circle-" + std::to_string(i));
+            }
+            eliasFanoWriter.build(eliasFanoFileName);
+            RoaringGeoMapReader eliasFanoReader(eliasFanoFileName);
+            QueryContext eliasFanoContext;
+            benchmarkQueryExecution("Contains (Elias-Fano cell filter)", 2000, indexedCellIds,
+                                    [&](const S2CellUnion& cellUnion) {
+                                        return eliasFanoReader.Contains(cellUnion, eliasFanoContext).size();
+                                    });
+
+            // Covers of 10k to 100k cells over a state sized region.
+            for (auto maxCells : {10000, 50000, 100000}) {
+                benchmarkLargeCoverQueryExecution(reader, 20, maxCells, 500000);
+            }
         }
     }
     return 0;
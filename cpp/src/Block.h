@@ -4,11 +4,23 @@
 #include "io/FileReadBuffer.h"
 #include "WriteHelpers.h"
 #include "VectorView.h"
+#include "SearchKernels.h"
+#include <algorithm>
+#include <span>
+#include <stdexcept>
 
 inline uint64_t determineBlocks(uint32_t blockSize, uint32_t totalEntries) {
     return totalEntries % blockSize > 0 ? (totalEntries / blockSize) + 1 : totalEntries / blockSize;
 }
 
+// Frozen roaring bitmaps must start on a 32 byte boundary to be viewed in place.
+const uint64_t FROZEN_BITMAP_ALIGNMENT = 32;
+
+// Rounds offset up to the next multiple of alignment.
+inline uint64_t alignOffset(uint64_t offset, uint64_t alignment) {
+    return ((offset + alignment - 1) / alignment) * alignment;
+}
+
 template<typename T>
 class BlockValues {
 public:
@@ -16,22 +28,54 @@ public:
     std::vector<T> values;
 };
 
+// BlockWriter writes variable sized values as a table of value end offsets followed by the values. When valueAlignment
+// is greater than 1 the first value and every following value start at a file offset that is a multiple of
+// valueAlignment, the gaps are zero filled and the offsets table still records the exact end of each value.
+// Values are held as they are inserted until the block is written, T is expected to be a pointer or a view such as
+// std::span of data that outlives the block so a block never copies the bytes it writes.
 template<typename T>
 class BlockWriter {
 public:
-    explicit BlockWriter(uint64_t blockSize) : blockSize(blockSize) {};
+    explicit BlockWriter(uint64_t blockSize, uint64_t valueAlignment = 1) : blockSize(blockSize),
+                                                                            valueAlignment(valueAlignment) {
+        valueSizes.reserve(blockSize);
+        values.reserve(blockSize);
+    };
 
     std::pair<uint64_t, T> WriteBlock(FileWriteBuffer &f) {
-        uint64_t valueDataSize = 0;
-        for (uint64_t size: valueSizes) {
-            valueDataSize += size;
-            writeLittleEndianUint64(f, valueDataSize);
-        }
-        for (T value: values) {
+        auto blockStart = f.offset();
+        // The offsets table is written with a single write.
+        f.write([&](char *data) { writeOffsets(data); }, valueSizes.size() * sizeof(uint64_t));
+        for (const T &value: values) {
+            if (valueAlignment > 1)
+                f.writePadding(valueAlignment);
             writeValue(f, value);
         }
-        return {(values.size() * sizeof(uint64_t)) + valueDataSize,
-                values.back()}; // Returns size of block and largest value in block;
+        return {f.offset() - blockStart, values.back()}; // Returns size of block and largest value in block;
+    };
+
+    // Size of the block when written at file offset blockStart, the padding before the first value depends on it.
+    uint64_t sizeAt(uint64_t blockStart) const {
+        uint64_t end = blockStart + valueSizes.size() * sizeof(uint64_t);
+        for (uint64_t size: valueSizes)
+            end = alignOffset(end, valueAlignment) + size;
+        return end - blockStart;
+    };
+
+    // Writes the same bytes as WriteBlock at file offset blockStart of space already reserved in f, without moving the
+    // write position. Blocks laid out with sizeAt may be written from several threads at once.
+    std::pair<uint64_t, T> WriteBlockAt(FileWriteBuffer &f, uint64_t blockStart) {
+        uint64_t position = blockStart + valueSizes.size() * sizeof(uint64_t);
+        f.writeAt(blockStart, [&](char *data) { writeOffsets(data); }, valueSizes.size() * sizeof(uint64_t));
+        for (size_t i = 0; i < values.size(); ++i) {
+            uint64_t valueStart = alignOffset(position, valueAlignment);
+            if (valueStart > position)
+                f.writeAt(position, [&](char *data) { std::fill(data, data + (valueStart - position), 0); },
+                          valueStart - position);
+            writeValueAt(f, valueStart, values[i]);
+            position = valueStart + valueSizes[i];
+        }
+        return {position - blockStart, values.back()};
     };
 
     std::pair<uint64_t, T> WriteBlockZstdCompressed(FileWriteBuffer &f) {
@@ -43,27 +87,52 @@ public:
         if (values.size() >= blockSize)
             return false;
         valueSizes.emplace_back(size);
-        values.emplace_back(value);
+        values.emplace_back(std::move(value));
         return true;
     };
 
+    // Empties the block so it can be filled again, keeping the memory already allocated for its values.
+    void clear() {
+        valueSizes.clear();
+        values.clear();
+    };
+
     // Must be overridden by implementing class
     virtual void writeValue(FileWriteBuffer &f, T value) {
         auto x = 10;
     };
+
+    // Must be overridden by implementing classes written with WriteBlockAt
+    virtual void writeValueAt(FileWriteBuffer &f, uint64_t offset, T value) {
+        throw std::runtime_error("block writer does not support writing at an offset");
+    };
 private:
     uint64_t blockSize;
+    uint64_t valueAlignment;
     std::vector<uint64_t> valueSizes;
     std::vector<T> values;
+
+    // Stores the end offset of each value, values are aligned relative to the start of the value section, which is
+    // itself aligned in the file.
+    void writeOffsets(char *data) const {
+        uint64_t valueDataSize = 0;
+        for (uint64_t size: valueSizes) {
+            valueDataSize = alignOffset(valueDataSize, valueAlignment) + size;
+            storeLittleEndianUint64(data, valueDataSize);
+            data += sizeof(uint64_t);
+        }
+    };
 };
 
 template<typename T>
 class FixedBlockWriter {
 public:
-    explicit FixedBlockWriter(uint64_t blockSize) : blockSize(blockSize) {}
+    explicit FixedBlockWriter(uint64_t blockSize) : blockSize(blockSize) {
+        values.reserve(blockSize);
+    }
 
     std::pair<uint64_t, T> WriteBlock(FileWriteBuffer &f) {
-        for (uint64_t value: values) {
+        for (const T &value: values) {
             writeValue(f, value);
         }
         return {values.size() * sizeof(T),
@@ -92,25 +161,33 @@ private:
 };
 
 
+// BlockReader reads blocks written by BlockWriter, valueAlignment must match the alignment the block was written with.
 template<typename T>
 class BlockReader {
 public:
-    explicit BlockReader(FileReadBuffer &f, uint64_t position, uint64_t size, uint64_t entries) :
+    explicit BlockReader(FileReadBuffer &f, uint64_t position, uint64_t size, uint64_t entries,
+                         uint64_t valueAlignment = 1) :
             f(f),
             position(position),
-            valuePosition(position + (entries * sizeof(uint64_t))), // start position of the values.
+            valuePosition(alignOffset(position + (entries * sizeof(uint64_t)),
+                                      valueAlignment)), // start position of the values.
             size(size),
             entries(entries),
+            valueAlignment(valueAlignment),
             offsets(VectorView<uint64_t>(f, position, entries)) {};
 
+    T readIndex(uint32_t index) {
+        if (index >= entries) {
+            throw std::out_of_range("Index out of bounds");
+        }
+        auto [pos, valueSize] = valuePos(index);
+        return readValue(f, pos, valueSize);
+    };
+
     std::vector<T> readIndexes(const std::vector<uint32_t> &indexes) {
         std::vector<T> valueRefs;
         for (auto index: indexes) {
-            uint64_t offset = index == 0 ? 0 : offsets[index - 1];
-            auto pos = valuePosition + offset;
-            std::integral auto valueSize = index == 0
-                                           ? offsets[index]
-                                           : offsets[index] - offsets[index - 1];
+            auto [pos, valueSize] = valuePos(index);
             valueRefs.emplace_back(readValue(f, pos, valueSize));
         }
         return valueRefs;
@@ -131,13 +208,7 @@ public:
 
             // Read all values within the range
             for (uint32_t index = start; index <= end; ++index) {
-                uint64_t offset = (index == 0) ? 0 : offsets[index - 1];
-                auto pos = valuePosition + offset;
-
-                std::integral auto valueSize = (index == 0)
-                                               ? offsets[index]
-                                               : offsets[index] - offsets[index - 1];
-
+                auto [pos, valueSize] = valuePos(index);
                 valueRefs.emplace_back(readValue(f, pos, valueSize));
             }
         }
@@ -150,14 +221,32 @@ public:
         return {};
     };
 
-private:
+    // Size of the block in the file in bytes.
+    uint64_t sizeOf() const {
+        return size;
+    };
+
+    uint64_t entryCount() const {
+        return entries;
+    };
+
+protected:
     FileReadBuffer &f;
+
+    // Returns the absolute position and size of the value at index. Offsets record the end of each value, the start
+    // of a value is the end of the previous value rounded up to the block's value alignment.
+    std::pair<uint64_t, uint64_t> valuePos(uint32_t index) {
+        uint64_t start = index == 0 ? 0 : alignOffset(offsets[index - 1], valueAlignment);
+        return {valuePosition + start, offsets[index] - start};
+    }
+
+private:
     uint64_t position;
     uint64_t valuePosition;
     uint64_t size;
     uint64_t entries;
+    uint64_t valueAlignment;
     VectorView<uint64_t> offsets;
-
 };
 
 template<std::integral T>
@@ -170,56 +259,56 @@ public:
                                                                                                                position,
                                                                                                                entries)) {};
 
-    std::vector<uint32_t> queryValueIndexes(const std::vector<T> &queryValues) {
-        // TODO: validate it is not out of bounds
-        std::vector<uint32_t> indexes;
-        for (auto value: queryValues) {
-            // todo use bitmask and vector instructions to find this faster. We likely can improve this with a modified
-            // binary search that does not start from the beginning each time.
-            auto it = std::lower_bound(values.begin(), values.end(), value); // bin
-
-            // In theory, we should never be reading a block for a value we do not know is there.
-            if (it != values.end()) {
-                indexes.emplace_back(std::distance(values.begin(), it));
+    // Writes the index of each query value present in the block to indexes, which is cleared first. Query values are
+    // expected in ascending order, as planned by the block index, each search then starts where the previous one ended.
+    void queryValueIndexes(std::span<const T> queryValues, std::vector<uint32_t> &indexes) {
+        if constexpr (std::is_same_v<T, uint64_t>) {
+            SearchKernels::best().findValues(values.data(), values.size(), queryValues, indexes);
+        } else {
+            indexes.clear();
+            for (auto value: queryValues) {
+                auto it = std::lower_bound(values.begin(), values.end(), value);
+                // The cell filter can report values that are not in the index, only exact matches are returned.
+                if (it != values.end() && *it == value) {
+                    indexes.emplace_back(std::distance(values.begin(), it));
+                }
             }
         }
-        return indexes;
     };
 
-    std::vector<std::pair<uint32_t, uint32_t>>
-    queryValueRangesIndexes(const std::vector<std::pair<T, T>> &queryRanges) {
-        // TODO: validate it is not out of bounds
-        std::vector<std::pair<uint32_t, uint32_t>> indexRanges;
-
-        for (const auto &range: queryRanges) {
-            // Find the start of the range
-            auto lowerIt = std::lower_bound(values.begin(), values.end(), range.first);
-            // Find the end of the range (exclusive)
-            auto upperIt = std::upper_bound(lowerIt, values.end(), range.second);
-
-            if (lowerIt != values.end() && lowerIt < upperIt) {
-                // Calculate the start and end indexes for this range
+    // Writes the inclusive index range of the block's values within each query range to indexRanges, which is cleared
+    // first. Overlapping index ranges are merged. Query ranges are expected in ascending order.
+    void queryValueRangesIndexes(std::span<const std::pair<T, T>> queryRanges,
+                                 std::vector<std::pair<uint32_t, uint32_t>> &indexRanges) {
+        if constexpr (std::is_same_v<T, uint64_t>) {
+            SearchKernels::best().findRanges(values.data(), values.size(), queryRanges, indexRanges);
+        } else {
+            indexRanges.clear();
+            for (const auto &range: queryRanges) {
+                auto lowerIt = std::lower_bound(values.begin(), values.end(), range.first);
+                auto upperIt = std::upper_bound(lowerIt, values.end(), range.second);
+                if (lowerIt == upperIt)
+                    continue;
                 auto startIndex = static_cast<uint32_t>(std::distance(values.begin(), lowerIt));
-                auto endIndex = static_cast<uint32_t>(std::distance(values.begin(), upperIt));
-
-                // if the range is not contained in the block then the last index would be the blocksize-1;
-                if (upperIt == values.end()) {
-                    endIndex--;
-                }
-
+                auto endIndex = static_cast<uint32_t>(std::distance(values.begin(), upperIt)) - 1;
                 if (!indexRanges.empty() && indexRanges.back().second >= startIndex) {
-                    // Merge overlapping or adjacent ranges; note we probably don;t have to do this if we assume all
-                    // input is from s2 region covers.
                     indexRanges.back().second = std::max(indexRanges.back().second, endIndex);
                 } else {
-                    // Add a new range
                     indexRanges.emplace_back(startIndex, endIndex);
                 }
             }
         }
+    };
 
-        return indexRanges;
+    // Size of the block in the file in bytes.
+    uint64_t sizeOf() const {
+        return size;
     };
+
+    uint64_t entryCount() const {
+        return entries;
+    };
+
 private:
     FileReadBuffer &f;
     uint64_t position;
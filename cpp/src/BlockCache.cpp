@@ -0,0 +1,44 @@
+#include "BlockCache.h"
+
+BlockCache::BlockCache(uint64_t capacityInBytes) : capacity(capacityInBytes) {}
+
+std::shared_ptr<const void> BlockCache::get(uint64_t key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return nullptr;
+    // Move the entry to the front of the LRU list.
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->block;
+}
+
+std::shared_ptr<const void> BlockCache::insert(uint64_t key, std::shared_ptr<const void> block, uint64_t cost) {
+    // Blocks larger than the whole budget are returned without being cached.
+    if (cost > capacity)
+        return block;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->block;
+    }
+
+    // Evict least recently used blocks until the new block fits.
+    while (size + cost > capacity && !lru.empty()) {
+        auto &evicted = lru.back();
+        size -= evicted.cost;
+        entries.erase(evicted.key);
+        lru.pop_back();
+    }
+
+    lru.push_front({key, block, cost});
+    entries.emplace(key, lru.begin());
+    size += cost;
+    return block;
+}
+
+BlockCacheStats BlockCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return {hitCount.load(std::memory_order_relaxed), missCount.load(std::memory_order_relaxed), size, capacity};
+}
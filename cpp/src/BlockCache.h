@@ -0,0 +1,79 @@
+#ifndef ROARINGGEOMAPS_BLOCKCACHE_H
+#define ROARINGGEOMAPS_BLOCKCACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <utility>
+
+// Columns whose blocks can be cached, used as part of the cache key.
+enum class BlockColumn : uint8_t {
+    CellId = 0,
+    Bitmap = 1,
+    Key = 2
+};
+
+struct BlockCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t sizeInBytes;
+    uint64_t capacityInBytes;
+};
+
+// BlockCache is a thread safe LRU cache of decoded blocks keyed by (column, blockId) and bounded by a byte budget.
+// Values are shared, an evicted block stays alive until the last query using it releases it. A cache with a capacity
+// of 0 is disabled and loads every block.
+class BlockCache {
+public:
+    explicit BlockCache(uint64_t capacityInBytes);
+
+    // Returns the cached block or loads, caches and returns it. load must return a pair of std::shared_ptr<T> and the
+    // cost of the block in bytes. Every block cached for a column must have the same type T.
+    template<typename T, typename Loader>
+    std::shared_ptr<const T> getOrLoad(BlockColumn column, uint32_t blockId, Loader &&load) {
+        if (capacity == 0) {
+            return load().first;
+        }
+
+        auto key = cacheKey(column, blockId);
+        if (auto cached = get(key)) {
+            hitCount.fetch_add(1, std::memory_order_relaxed);
+            return std::static_pointer_cast<const T>(cached);
+        }
+        missCount.fetch_add(1, std::memory_order_relaxed);
+
+        // Loading happens outside the lock, if another thread cached the block in the meantime its copy is kept.
+        auto [block, cost] = load();
+        return std::static_pointer_cast<const T>(insert(key, std::shared_ptr<const void>(std::move(block)), cost));
+    }
+
+    BlockCacheStats stats() const;
+
+private:
+    struct Entry {
+        uint64_t key;
+        std::shared_ptr<const void> block;
+        uint64_t cost;
+    };
+
+    uint64_t capacity;
+    uint64_t size = 0;
+    std::list<Entry> lru; // Most recently used first.
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> entries;
+    mutable std::mutex mutex;
+    std::atomic<uint64_t> hitCount = 0;
+    std::atomic<uint64_t> missCount = 0;
+
+    static uint64_t cacheKey(BlockColumn column, uint32_t blockId) {
+        return (static_cast<uint64_t>(column) << 32) | blockId;
+    }
+
+    std::shared_ptr<const void> get(uint64_t key);
+
+    std::shared_ptr<const void> insert(uint64_t key, std::shared_ptr<const void> block, uint64_t cost);
+};
+
+#endif //ROARINGGEOMAPS_BLOCKCACHE_H
@@ -0,0 +1,76 @@
+#include "BlockIndexTree.h"
+#include "Block.h"
+#include "WriteHelpers.h"
+#include <algorithm>
+#include <limits>
+
+std::vector<uint64_t> blockIndexTreeLayers(uint64_t entries) {
+    std::vector<uint64_t> layers;
+    uint64_t keys = entries;
+    while (keys > BLOCK_INDEX_TREE_FANOUT) {
+        // One key per node of the layer below.
+        keys = determineBlocks(BLOCK_INDEX_TREE_FANOUT, keys);
+        layers.push_back(keys);
+    }
+    return layers;
+}
+
+uint64_t BlockIndexTreeWriter::writeToFile(FileWriteBuffer &f) const {
+    auto [paddingPos, paddingSize] = f.writePadding(BLOCK_INDEX_TREE_ALIGNMENT);
+
+    // Build the layers bottom up, each key is the last (largest) key of a node of the layer below.
+    std::vector<std::vector<uint64_t>> layers;
+    const std::vector<uint64_t> *below = &values;
+    for (auto keys: blockIndexTreeLayers(values.size())) {
+        std::vector<uint64_t> layer;
+        layer.reserve(keys);
+        for (uint64_t i = 0; i < keys; ++i) {
+            layer.push_back((*below)[std::min((i + 1) * BLOCK_INDEX_TREE_FANOUT, below->size()) - 1]);
+        }
+        layers.push_back(std::move(layer));
+        below = &layers.back();
+    }
+
+    uint64_t size = paddingSize;
+    for (auto layer = layers.rbegin(); layer != layers.rend(); ++layer) {
+        uint64_t nodes = determineBlocks(BLOCK_INDEX_TREE_FANOUT, layer->size());
+        for (uint64_t i = 0; i < nodes * BLOCK_INDEX_TREE_FANOUT; ++i) {
+            writeLittleEndianUint64(f, i < layer->size() ? (*layer)[i] : std::numeric_limits<uint64_t>::max());
+        }
+        size += nodes * BLOCK_INDEX_TREE_FANOUT * sizeof(uint64_t);
+    }
+    return size;
+}
+
+BlockIndexTreeReader::BlockIndexTreeReader(FileReadBuffer &f, uint64_t pos, VectorView<uint64_t> leaves) :
+        leaves(leaves), kernels(SearchKernels::best()) {
+    auto treePos = alignOffset(pos, BLOCK_INDEX_TREE_ALIGNMENT);
+    auto layerKeys = blockIndexTreeLayers(leaves.size());
+    uint64_t offset = 0;
+    for (auto keys = layerKeys.rbegin(); keys != layerKeys.rend(); ++keys) {
+        layers.emplace_back(offset, *keys);
+        offset += determineBlocks(BLOCK_INDEX_TREE_FANOUT, *keys) * BLOCK_INDEX_TREE_FANOUT;
+    }
+    size = treePos - pos + offset * sizeof(uint64_t);
+    if (offset > 0)
+        tree = f.view(treePos, offset * sizeof(uint64_t));
+}
+
+uint32_t BlockIndexTreeReader::lowerBound(uint64_t value) const {
+    // Descend from the root, in each node the number of keys less than value is the child holding the first value not
+    // less than value.
+    uint64_t node = 0;
+    for (const auto &[offset, keys]: layers) {
+        const char *keysPos = tree + (offset + node * BLOCK_INDEX_TREE_FANOUT) * sizeof(uint64_t);
+        uint64_t child = node * BLOCK_INDEX_TREE_FANOUT + kernels.countLessThan(keysPos, BLOCK_INDEX_TREE_FANOUT, value);
+        // Only the root can be passed entirely, any other node is only entered when its largest key is not less than
+        // value.
+        if (child >= keys)
+            return static_cast<uint32_t>(leaves.size());
+        node = child;
+    }
+
+    uint64_t first = node * BLOCK_INDEX_TREE_FANOUT;
+    auto count = static_cast<uint32_t>(std::min<uint64_t>(BLOCK_INDEX_TREE_FANOUT, leaves.size() - first));
+    return static_cast<uint32_t>(first + kernels.countLessThan(leaves.data() + first * sizeof(uint64_t), count, value));
+}
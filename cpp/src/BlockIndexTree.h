@@ -0,0 +1,69 @@
+#ifndef ROARINGGEOMAPS_BLOCKINDEXTREE_H
+#define ROARINGGEOMAPS_BLOCKINDEXTREE_H
+
+#include <cstdint>
+#include <vector>
+#include "io/FileReadBuffer.h"
+#include "io/FileWriteBuffer.h"
+#include "VectorView.h"
+#include "SearchKernels.h"
+
+// Keys per node of the block index tree, a node fills one 64 byte cache line.
+const uint32_t BLOCK_INDEX_TREE_FANOUT = 8;
+const uint64_t BLOCK_INDEX_TREE_ALIGNMENT = 64;
+
+// Number of keys in each internal layer of the tree over entries sorted values, from the layer above the values up to
+// the root. Values fitting in a single node have no internal layers.
+std::vector<uint64_t> blockIndexTreeLayers(uint64_t entries);
+
+/*
+ * The block index tree is a static B+tree over the sorted block index. Its leaves are the sorted block index itself,
+ * grouped in nodes of BLOCK_INDEX_TREE_FANOUT values, so a search returns the position of a block in the block index
+ * and the block index can still be merged with a query in order. Each internal key is the largest value below it.
+ *
+ * Tree Format
+ * [zero padding to a 64 byte aligned file offset]
+ * [root layer keys uint64 * 8]
+ * [next layer keys uint64 * 8 * nodes]
+ * ...
+ * [layer above the block index keys uint64 * 8 * nodes]
+ *
+ * Each layer is padded to whole nodes with the max uint64, so every node read is one aligned cache line and a search
+ * reads one line per layer rather than one per probe of a binary search.
+ */
+class BlockIndexTreeWriter {
+public:
+    BlockIndexTreeWriter() = default;
+
+    void addValue(uint64_t value) {
+        values.push_back(value);
+    };
+
+    // Writes the padding and the tree and returns the number of bytes written.
+    uint64_t writeToFile(FileWriteBuffer &f) const;
+
+private:
+    std::vector<uint64_t> values;
+};
+
+class BlockIndexTreeReader {
+public:
+    // pos is the offset the writer started at, before the padding. leaves is the sorted block index the tree is over.
+    BlockIndexTreeReader(FileReadBuffer &f, uint64_t pos, VectorView<uint64_t> leaves);
+
+    // Position of the first leaf not less than value, or the number of leaves when there is none.
+    uint32_t lowerBound(uint64_t value) const;
+
+    // Size of the tree in the file in bytes, including the padding before it.
+    uint64_t sizeOf() const { return size; };
+
+private:
+    VectorView<uint64_t> leaves;
+    const char *tree = nullptr;
+    // Key offset and key count of each internal layer, from the root down.
+    std::vector<std::pair<uint64_t, uint64_t>> layers;
+    uint64_t size = 0;
+    const SearchKernels &kernels;
+};
+
+#endif //ROARINGGEOMAPS_BLOCKINDEXTREE_H
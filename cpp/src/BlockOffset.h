@@ -11,15 +11,15 @@ class BlockOffsetReader {
 public:
     BlockOffsetReader(FileReadBuffer &f, uint64_t pos, uint64_t size) : blockOffsets(f, pos, size) {}
 
-    std::pair<uint64_t, uint64_t> BlockPos(uint32_t blockId) {
+    std::pair<uint64_t, uint64_t> BlockPos(uint32_t blockId) const {
         // TODO: throw exception if blockIndex is out of bounds;
         if (blockId == 0)
             return {0, blockOffsets[0]};
 
-        return {blockOffsets[blockId - 1], blockOffsets[blockId - 1] - blockOffsets[blockId]};
+        return {blockOffsets[blockId - 1], blockOffsets[blockId] - blockOffsets[blockId - 1]};
     }
 
-    uint64_t sizeOf() { return blockOffsets.size() * sizeof(uint64_t); }
+    uint64_t sizeOf() const { return blockOffsets.size() * sizeof(uint64_t); }
 
 private:
     VectorView<uint64_t> blockOffsets;
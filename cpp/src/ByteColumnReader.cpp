@@ -1,15 +1,19 @@
 #include "ByteColumnReader.h"
 
-ByteColumnReader::ByteColumnReader(FileReadBuffer &f, uint64_t startPos, uint32_t size, uint32_t entries,
+ByteColumnReader::ByteColumnReader(FileReadBuffer &f, uint64_t startPos, uint64_t size, uint32_t entries,
                                    uint16_t blockSize) :
         f(f),
         startPos(startPos),
         size(size),
         entries(entries),
         blockSize(blockSize),
-        blockOffset(f, startPos, determineBlocks(blockSize, entries)) {}
+        blockOffset(f, startPos, determineBlocks(blockSize, entries)) {
+    // Block offsets are read on every block access while keys are only fetched for query results.
+    f.advise(dataPos(), size - blockOffset.sizeOf(), FileReadBuffer::Advice::Random);
+    f.advise(startPos, blockOffset.sizeOf(), FileReadBuffer::Advice::WillNeed);
+}
 
-BytesBlockReader ByteColumnReader::ReadBlock(uint32_t block) {
+BytesBlockReader ByteColumnReader::ReadBlock(uint32_t block) const {
     auto [start, sizeOf] = blockOffset.BlockPos(block);
     uint32_t blockEntries = (block + 1) * blockSize <= entries ? blockSize : entries % blockSize;
     return BytesBlockReader(f, dataPos() + start, sizeOf, blockEntries);
@@ -3,6 +3,7 @@
 
 #include "BlockOffset.h"
 #include "Block.h"
+#include <string_view>
 
 class BytesBlockReader : public BlockReader<std::vector<char>> {
 public:
@@ -13,13 +14,22 @@ public:
         auto data = f.view(position, size);
         return {data, data + size};
     };
+
+    // Returns the value at index as a view over the read buffer, without copying it.
+    std::string_view readView(uint32_t index) {
+        if (index >= entryCount()) {
+            throw std::out_of_range("Index out of bounds");
+        }
+        auto [pos, valueSize] = valuePos(index);
+        return {f.view(pos, valueSize), valueSize};
+    };
 };
 
 class ByteColumnReader {
 public:
-    ByteColumnReader(FileReadBuffer &f, uint64_t startPos, uint32_t size, uint32_t entries, uint16_t blockSize);
+    ByteColumnReader(FileReadBuffer &f, uint64_t startPos, uint64_t size, uint32_t entries, uint16_t blockSize);
 
-    BytesBlockReader ReadBlock(uint32_t blockIndex);
+    BytesBlockReader ReadBlock(uint32_t blockIndex) const;
 
 private:
     FileReadBuffer &f;
@@ -29,7 +39,7 @@ private:
     uint32_t entries;
     uint64_t blockSize;
 
-    inline uint64_t dataPos() {
+    inline uint64_t dataPos() const {
         return startPos + blockOffset.sizeOf();
     }
 };
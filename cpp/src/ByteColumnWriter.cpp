@@ -5,7 +5,7 @@
 
 ByteColumnWriter::ByteColumnWriter(uint64_t blockSize) : blockSize(blockSize), currentWriteBlock(blockSize) {}
 
-void ByteColumnWriter::addBytes(const std::vector<char> &data) {
+void ByteColumnWriter::addBytes(std::span<const char> data) {
     bool blockComplete = !currentWriteBlock.insertValue(data, data.size());
     if (blockComplete) {
         blocks.push_back(std::move(currentWriteBlock));
@@ -24,7 +24,7 @@ uint64_t ByteColumnWriter::writeToFile(FileWriteBuffer &f) {
     // 2. write each block;
     BlockOffsetWriter blockOffsets;
     uint64_t blockOffset = 0;
-    for (auto block: blocks) {
+    for (auto &block: blocks) {
         auto blockInfo = block.WriteBlock(f);
         blockOffset += blockInfo.first;
         blockOffsets.InsertOffset(blockOffset);
@@ -33,7 +33,7 @@ uint64_t ByteColumnWriter::writeToFile(FileWriteBuffer &f) {
     f.seek(-1 * (blockOffset + blockOffsetSize));
     blockOffsets.writeToFile(f);
     // 4. seek back to the next write position which is the end of the block data.
-    f.seek(blockOffset + blockOffsetSize);
+    f.seek(blockOffset);
     // 5. return overall size of all bytes written.
     return blockOffsetSize + blockOffset;
 }
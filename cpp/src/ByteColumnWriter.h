@@ -1,14 +1,16 @@
 #include <vector>
 #include <memory>
+#include <span>
 #include "io/FileWriteBuffer.h"
 #include "Block.h"
 
 
-class BytesBlockWriter : public BlockWriter<std::vector<char>> {
+// Values are views of bytes held by the caller until the block is written.
+class BytesBlockWriter : public BlockWriter<std::span<const char>> {
 public:
-    explicit BytesBlockWriter(uint64_t blockSize) : BlockWriter<std::vector<char>>(blockSize) {};
+    explicit BytesBlockWriter(uint64_t blockSize) : BlockWriter<std::span<const char>>(blockSize) {};
 
-    void writeValue(FileWriteBuffer &f, std::vector<char> value) {
+    void writeValue(FileWriteBuffer &f, std::span<const char> value) override {
         f.write(value.data(), value.size());
     };
 };
@@ -17,12 +19,13 @@ class ByteColumnWriter {
 public:
     ByteColumnWriter(uint64_t blockSize);
 
-    void addBytes(const std::vector<char> &data);
+    // The bytes are not copied, they must live until the column is written.
+    void addBytes(std::span<const char> data);
 
     uint64_t writeToFile(FileWriteBuffer &f);
 
 private:
-    BytesBlockWriter blockSize;
+    uint64_t blockSize;
     BytesBlockWriter currentWriteBlock;
     std::vector<BytesBlockWriter> blocks;
 };
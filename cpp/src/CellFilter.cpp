@@ -1,5 +1,7 @@
 #include "CellFilter.h"
 #include "surf.hpp"
+#include <algorithm>
+#include <limits>
 
 CellFilter::CellFilter(const std::vector<std::string> &values)
         : filter(new surf::SuRF(values)) {}
@@ -9,43 +11,141 @@ CellFilter::CellFilter() = default;
 CellFilter::CellFilter(surf::SuRF *filter) : filter(filter) {
 }
 
-CellFilter::~CellFilter() {
-    delete filter;
-}
+CellFilter::CellFilter(EliasFanoSet cellSet) : filterType(CellFilterType::EliasFano),
+                                               cellSet(std::make_unique<EliasFanoSet>(std::move(cellSet))) {}
+
+CellFilter::CellFilter(CellFilter &&other) noexcept = default;
+
+CellFilter &CellFilter::operator=(CellFilter &&other) noexcept = default;
+
+CellFilter::~CellFilter() = default;
+
+CellFilter::Builder::Builder(CellFilterType type) : type(type) {}
 
 CellFilter CellFilter::Builder::build() {
-    std::sort(values.begin(), values.end());
+    std::sort(cellIds.begin(), cellIds.end());
+    cellIds.erase(std::unique(cellIds.begin(), cellIds.end()), cellIds.end());
+    if (type == CellFilterType::EliasFano)
+        return CellFilter(EliasFanoSet::build(cellIds));
+
+    // Big endian strings sort in the same order as the cell ids.
+    std::vector<std::string> values;
+    values.reserve(cellIds.size());
+    std::transform(cellIds.begin(), cellIds.end(), std::back_inserter(values),
+                   [](uint64_t cellId) {
+                       return surf::uint64ToString(cellId);
+                   });
     return CellFilter(values);
 }
 
 void CellFilter::Builder::insertMany(const std::vector<S2CellId> &insertValues) {
-    std::transform(insertValues.begin(), insertValues.end(), std::back_inserter(values),
+    std::transform(insertValues.begin(), insertValues.end(), std::back_inserter(cellIds),
                    [](const auto &cellId) {
-                       return surf::uint64ToString(cellId.id());
+                       return cellId.id();
                    });
 }
 
+void CellFilter::Builder::insertMany(std::span<const uint64_t> insertValues) {
+    cellIds.insert(cellIds.end(), insertValues.begin(), insertValues.end());
+}
+
+CellFilterType CellFilter::type() const {
+    return filterType;
+}
+
 std::pair<uint64_t, uint64_t> CellFilter::serialize(FileWriteBuffer &f) {
+    if (filterType == CellFilterType::EliasFano) {
+        // Words of the set are read in place, start them on a word boundary.
+        f.writePadding(sizeof(uint64_t));
+        return f.write(cellSet->data(), cellSet->sizeInBytes());
+    }
     return f.write(filter->serialize(), filter->serializedSize());
 }
 
-CellFilter CellFilter::deserialize(FileReadBuffer &f, uint64_t pos, uint64_t size) {
+CellFilter CellFilter::deserialize(FileReadBuffer &f, uint64_t pos, uint64_t size, CellFilterType type) {
+    if (type == CellFilterType::EliasFano)
+        return CellFilter(EliasFanoSet::view(f.view(pos, size), size));
     return CellFilter(surf::SuRF::deSerialize(const_cast<char *>(f.view(pos, size))));;
 }
 
-bool CellFilter::contains(uint64_t cellId) {
+bool CellFilter::contains(uint64_t cellId) const {
+    if (filterType == CellFilterType::EliasFano)
+        return cellSet->contains(cellId);
     return filter->lookupKey(surf::uint64ToString(cellId));
 }
 
-std::tuple<uint64_t, uint64_t, bool> CellFilter::containsRange(uint64_t minCellId, uint64_t maxCellId) {
+std::tuple<uint64_t, uint64_t, bool> CellFilter::containsRange(uint64_t minCellId, uint64_t maxCellId) const {
+    if (filterType == CellFilterType::EliasFano) {
+        uint64_t minVal = 0;
+        auto minIndex = cellSet->lowerBound(minCellId, minVal);
+        if (minIndex == cellSet->size() || minVal > maxCellId)
+            return {0, 0, false};
+        // The largest cell id in the range is the one before the first cell id past the range.
+        uint64_t maxIndex = cellSet->size();
+        if (maxCellId < std::numeric_limits<uint64_t>::max()) {
+            uint64_t next;
+            maxIndex = cellSet->lowerBound(maxCellId + 1, next);
+        }
+        uint64_t maxVal = maxIndex - 1 == minIndex ? minVal : cellSet->valueAt(maxIndex - 1);
+        return {minVal, maxVal, true};
+    }
+
     auto min = filter->moveToKeyGreaterThan(surf::uint64ToString(minCellId), true);
     auto max = filter->moveToKeyLessThan(surf::uint64ToString(maxCellId), true);
 
+    if (!min.isValid() || !max.isValid())
+        return {0, 0, false};
+
     auto minVal = surf::stringToUint64(min.getKey());
     auto maxVal = surf::stringToUint64(max.getKey());
-    // If max is greater, then min then the value is not present in the filter.
-    if (minVal < maxVal) {
+    // If max is greater, then min then the value is not present in the filter. Equal values mean a single cell is in
+    // the range.
+    if (minVal <= maxVal) {
         return {minVal, maxVal, true};
     }
     return {0, 0, false};
 }
+
+void CellFilter::containsMany(std::span<const uint64_t> cellIds, std::vector<uint64_t> &found) const {
+    if (filterType == CellFilterType::EliasFano) {
+        EliasFanoSet::Cursor cursor;
+        for (auto cellId: cellIds) {
+            uint64_t value = 0;
+            if (cellSet->lowerBound(cellId, value, cursor) < cellSet->size() && value == cellId)
+                found.emplace_back(cellId);
+        }
+        return;
+    }
+    // SuRF lookups start from the root, each probe is searched on its own.
+    for (auto cellId: cellIds) {
+        if (contains(cellId))
+            found.emplace_back(cellId);
+    }
+}
+
+void CellFilter::containsRangeMany(std::span<const std::pair<uint64_t, uint64_t>> ranges,
+                                   std::vector<std::pair<uint64_t, uint64_t>> &found) const {
+    if (filterType == CellFilterType::EliasFano) {
+        // The search for the end of a range continues from its start, and the next range from that end.
+        EliasFanoSet::Cursor cursor;
+        for (const auto &[minCellId, maxCellId]: ranges) {
+            uint64_t minVal = 0;
+            auto minIndex = cellSet->lowerBound(minCellId, minVal, cursor);
+            if (minIndex == cellSet->size() || minVal > maxCellId)
+                continue;
+            uint64_t maxIndex = cellSet->size();
+            if (maxCellId < std::numeric_limits<uint64_t>::max()) {
+                uint64_t next;
+                maxIndex = cellSet->lowerBound(maxCellId + 1, next, cursor);
+            }
+            uint64_t maxVal = maxIndex - 1 == minIndex ? minVal : cellSet->valueAt(maxIndex - 1);
+            found.emplace_back(minVal, maxVal);
+        }
+        return;
+    }
+    for (const auto &[minCellId, maxCellId]: ranges) {
+        auto [minVal, maxVal, present] = containsRange(minCellId, maxCellId);
+        if (present)
+            found.emplace_back(minVal, maxVal);
+    }
+}
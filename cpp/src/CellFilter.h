@@ -4,46 +4,76 @@
 #include <vector>
 #include <cstdint>
 #include <iostream>
+#include <span>
 #include "memory"
 #include "s2/s2cell_id.h"
 #include "io/FileWriteBuffer.h"
 #include "io/FileReadBuffer.h"
+#include "EliasFanoSet.h"
+#include "Header.h"
 
 namespace surf {
     class SuRF; // Forward declaration needed to avoid repeat definitions of SuRF.
 }
 
+// CellFilter answers whether cell ids, or any cell id within a range, were written to the index. It owns its
+// filter, it can be moved but not copied. Lookups do not modify the filter and may run from several threads at once.
 class CellFilter {
 private:
     // Private constructor to enforce the builder pattern
-    surf::SuRF *filter{};
+    CellFilterType filterType = CellFilterType::SuRF;
+    std::unique_ptr<surf::SuRF> filter;
+    std::unique_ptr<EliasFanoSet> cellSet;
 
     explicit CellFilter(surf::SuRF *filter);
 
+    explicit CellFilter(EliasFanoSet cellSet);
+
 public:
     explicit CellFilter(const std::vector<std::string> &values);
 
     explicit CellFilter();
 
+    CellFilter(CellFilter &&other) noexcept;
+
+    CellFilter &operator=(CellFilter &&other) noexcept;
+
     ~CellFilter();
 
     // Builder class to construct the CellFilter object
     class Builder {
     private:
-        std::vector<std::string> values;
+        CellFilterType type;
+        std::vector<uint64_t> cellIds;
     public:
+        explicit Builder(CellFilterType type = CellFilterType::SuRF);
+
         CellFilter build();
 
         void insertMany(const std::vector<S2CellId> &insertValues);
+
+        void insertMany(std::span<const uint64_t> insertValues);
     };
 
+    CellFilterType type() const;
+
     std::pair<uint64_t, uint64_t> serialize(FileWriteBuffer &f);
 
-    static CellFilter deserialize(FileReadBuffer &f, uint64_t pos, uint64_t size);
+    static CellFilter deserialize(FileReadBuffer &f, uint64_t pos, uint64_t size,
+                                  CellFilterType type = CellFilterType::SuRF);
+
+    bool contains(uint64_t cellId) const;
+
+    std::tuple<uint64_t, uint64_t, bool> containsRange(uint64_t minCellId, uint64_t maxCellId) const;
 
-    bool contains(uint64_t cellId);
+    // Appends each of cellIds present in the filter to found. Probes are expected in ascending order, the Elias-Fano
+    // filter then continues each search from where the previous one ended.
+    void containsMany(std::span<const uint64_t> cellIds, std::vector<uint64_t> &found) const;
 
-    std::tuple<uint64_t, uint64_t, bool> containsRange(uint64_t minCellId, uint64_t maxCellId);
+    // Appends the smallest and largest cell id present within each of ranges to found, ranges without any cell id
+    // present are skipped. Ranges are expected sorted and not overlapping, as the child ranges of a normalized cover.
+    void containsRangeMany(std::span<const std::pair<uint64_t, uint64_t>> ranges,
+                           std::vector<std::pair<uint64_t, uint64_t>> &found) const;
 };
 
 #endif //ROARINGGEOMAPS_CELLFILTER_H
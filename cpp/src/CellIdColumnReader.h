@@ -6,6 +6,7 @@
 #include "Block.h"
 #include "ReaderHelpers.h"
 #include "S2BlockIndexReader.h"
+#include "Header.h"
 #include <set>
 #include <cmath>
 
@@ -17,13 +18,15 @@ public:
 
 class CellIdColumnReader {
 public:
-    CellIdColumnReader(FileReadBuffer &f, uint64_t startPos, uint64_t size, uint32_t entries, uint16_t blockSize);
+    CellIdColumnReader(FileReadBuffer &f, uint64_t startPos, uint64_t size, uint32_t entries, uint16_t blockSize,
+                       BlockIndexLayout blockIndexLayout = BlockIndexLayout::Sorted);
 
-    Uint64BlockReader ReadBlock(uint32_t blockIndex);
+    Uint64BlockReader ReadBlock(uint32_t blockIndex) const;
 
-    std::vector<uint32_t> FilterIndexBlock(uint64_t blockId, std::vector<uint64_t> &values);
+    // Returns the index within the block of each of values present in the block, values must be sorted.
+    std::vector<uint32_t> FilterIndexBlock(uint32_t blockId, std::span<const uint64_t> values) const;
 
-    S2BlockIndexReader &BlockIndex();
+    const S2BlockIndexReader &BlockIndex() const;
 
 private:
     FileReadBuffer &f;
@@ -34,7 +37,7 @@ private:
     uint32_t entries;
     uint64_t blockSize;
 
-    inline uint64_t dataPos() {
+    inline uint64_t dataPos() const {
         return startPos + blockIndex.sizeOf() + blockOffset.sizeOf();
     }
 };
@@ -2,7 +2,8 @@
 #include "WriteHelpers.h"
 #include "Block.h"
 
-CellIdColumnWriter::CellIdColumnWriter(uint64_t blockSize) : blockSize(blockSize), currentWriteBlock(blockSize) {}
+CellIdColumnWriter::CellIdColumnWriter(uint64_t blockSize, BlockIndexLayout blockIndexLayout) :
+        blockSize(blockSize), blockIndexLayout(blockIndexLayout), currentWriteBlock(blockSize) {}
 
 void CellIdColumnWriter::addValue(uint64_t value) {
     bool blockComplete = !currentWriteBlock.insertValue(value);
@@ -22,19 +23,25 @@ uint64_t CellIdColumnWriter::writeToFile(FileWriteBuffer &f) {
     // 2. write each block;
     BlockOffsetWriter blockOffsets;
     BlockIndexWriter<uint64_t> blockIndex;
+    BlockIndexTreeWriter blockIndexTree;
     uint64_t blockOffset = 0;
-    for (auto block: blocks) {
+    for (auto &block: blocks) {
         auto blockInfo = block.WriteBlock(f);
         blockOffset += blockInfo.first;
         blockOffsets.InsertOffset(blockOffset);
         blockIndex.addValue(blockInfo.second);
+        blockIndexTree.addValue(blockInfo.second);
     }
     // 3. seek back to the start of buffer and write block index and block offset
     f.seek(-1 * (blockOffset + blockIndexAndOffsetSize));
     blockIndex.writeToFile(f);
     blockOffsets.writeToFile(f);
     // 4. seek back to the next write position which is the end of the block data.
-    f.seek(blockOffset + blockIndexAndOffsetSize);
-    // 5. return overall size of all bytes written.
-    return blockIndexAndOffsetSize + blockOffset;
+    f.seek(blockOffset);
+    // 5. write the block index tree after the blocks when enabled.
+    uint64_t treeSize = 0;
+    if (blockIndexLayout == BlockIndexLayout::BTree)
+        treeSize = blockIndexTree.writeToFile(f);
+    // 6. return overall size of all bytes written.
+    return blockIndexAndOffsetSize + blockOffset + treeSize;
 }
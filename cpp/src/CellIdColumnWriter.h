@@ -7,6 +7,8 @@
 #include "BlockIndexWriter.h"
 #include "BlockOffset.h"
 #include "Block.h"
+#include "BlockIndexTree.h"
+#include "Header.h"
 
 class Uint64BlockWriter : public FixedBlockWriter<uint64_t> {
 public:
@@ -19,7 +21,7 @@ public:
 
 class CellIdColumnWriter {
 public:
-    explicit CellIdColumnWriter(uint64_t blockSize);
+    explicit CellIdColumnWriter(uint64_t blockSize, BlockIndexLayout blockIndexLayout = BlockIndexLayout::Sorted);
 
     void addValue(uint64_t value);
 
@@ -29,6 +31,7 @@ public:
 
 private:
     uint64_t blockSize;
+    BlockIndexLayout blockIndexLayout;
     Uint64BlockWriter currentWriteBlock;
     std::vector<Uint64BlockWriter> blocks;
 };
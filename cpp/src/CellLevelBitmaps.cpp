@@ -0,0 +1,116 @@
+#include "CellLevelBitmaps.h"
+#include "Block.h"
+#include "ReaderHelpers.h"
+#include "WriteHelpers.h"
+#include <bit>
+
+namespace {
+    const uint64_t TABLE_SIZE = CELL_LEVELS * sizeof(uint64_t);
+
+    inline int cellLevel(uint64_t cellId) {
+        // The lowest set bit of a cell id marks its level, two bits per level below the leaf level.
+        return S2CellId::kMaxLevel - std::countr_zero(cellId) / 2;
+    }
+
+    inline uint64_t levelPosition(uint64_t cellId, int level) {
+        return cellId >> (2 * (S2CellId::kMaxLevel - level) + 1);
+    }
+
+    inline uint64_t cellIdAt(uint64_t position, int level) {
+        uint64_t shift = 2 * (S2CellId::kMaxLevel - level);
+        return (position << (shift + 1)) | (uint64_t(1) << shift);
+    }
+
+    // Frozen views hold pointers into the read buffer, returning them by value keeps them from being copied.
+    roaring::Roaring64Map frozenLevel(FileReadBuffer &f, uint64_t pos, uint64_t size) {
+        return roaring::Roaring64Map::frozenView(f.view(pos, size));
+    }
+}
+
+void CellLevelBitmapsWriter::addCells(std::span<const uint64_t> cellIds) {
+    for (auto cellId: cellIds) {
+        int level = cellLevel(cellId);
+        levels[level].add(levelPosition(cellId, level));
+    }
+}
+
+uint64_t CellLevelBitmapsWriter::writeToFile(FileWriteBuffer &f) {
+    auto [paddingPos, paddingSize] = f.writePadding(FROZEN_BITMAP_ALIGNMENT);
+    uint64_t bitmapsStart = alignOffset(TABLE_SIZE, FROZEN_BITMAP_ALIGNMENT);
+
+    std::array<uint64_t, CELL_LEVELS> ends{};
+    uint64_t end = 0;
+    for (int level = 0; level < CELL_LEVELS; ++level) {
+        if (!levels[level].isEmpty()) {
+            levels[level].runOptimize();
+            end = alignOffset(end, FROZEN_BITMAP_ALIGNMENT) + levels[level].getFrozenSizeInBytes();
+        }
+        ends[level] = end;
+    }
+    for (auto levelEnd: ends) {
+        writeLittleEndianUint64(f, levelEnd);
+    }
+    f.writePadding(FROZEN_BITMAP_ALIGNMENT);
+
+    for (const auto &bitmap: levels) {
+        if (bitmap.isEmpty())
+            continue;
+        f.writePadding(FROZEN_BITMAP_ALIGNMENT);
+        f.write([&](char *buffer) { bitmap.writeFrozen(buffer); }, bitmap.getFrozenSizeInBytes());
+    }
+    return paddingSize + bitmapsStart + end;
+}
+
+CellLevelBitmapsReader::CellLevelBitmapsReader(FileReadBuffer &f, uint64_t pos, uint64_t size) {
+    auto tablePos = alignOffset(pos, FROZEN_BITMAP_ALIGNMENT);
+    auto bitmapsPos = tablePos + alignOffset(TABLE_SIZE, FROZEN_BITMAP_ALIGNMENT);
+    if (bitmapsPos > pos + size)
+        throw std::runtime_error("Cell level bitmaps are truncated");
+
+    levels.reserve(CELL_LEVELS);
+    uint64_t start = 0;
+    for (int level = 0; level < CELL_LEVELS; ++level) {
+        auto end = readLittleEndianUint64(f, tablePos + level * sizeof(uint64_t));
+        if (end > start) {
+            start = alignOffset(start, FROZEN_BITMAP_ALIGNMENT);
+            if (bitmapsPos + end > pos + size)
+                throw std::runtime_error("Cell level bitmaps are truncated");
+            levels.emplace_back(frozenLevel(f, bitmapsPos + start, end - start));
+            cellCounts[level] = levels.back().cardinality();
+        } else {
+            levels.emplace_back();
+        }
+        start = end;
+    }
+}
+
+bool CellLevelBitmapsReader::contains(uint64_t cellId) const {
+    int level = cellLevel(cellId);
+    return !levels[level].isEmpty() && levels[level].contains(levelPosition(cellId, level));
+}
+
+void CellLevelBitmapsReader::containsMany(std::span<const uint64_t> cellIds, std::vector<uint64_t> &found) const {
+    // Group the probes by level, cells of every level are interleaved along the curve.
+    std::array<std::vector<uint64_t>, CELL_LEVELS> probes;
+    for (auto cellId: cellIds) {
+        int level = cellLevel(cellId);
+        if (!levels[level].isEmpty())
+            probes[level].push_back(levelPosition(cellId, level));
+    }
+
+    for (int level = 0; level < CELL_LEVELS; ++level) {
+        const auto &positions = probes[level];
+        if (positions.size() < CELL_LEVEL_INTERSECT_MIN_PROBES) {
+            for (auto position: positions) {
+                if (levels[level].contains(position))
+                    found.emplace_back(cellIdAt(position, level));
+            }
+            continue;
+        }
+        roaring::Roaring64Map present;
+        present.addMany(positions.size(), positions.data());
+        present &= levels[level];
+        for (auto position: present)
+            found.emplace_back(cellIdAt(position, level));
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef ROARINGGEOMAPS_CELLLEVELBITMAPS_H
+#define ROARINGGEOMAPS_CELLLEVELBITMAPS_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "roaring64map.hh"
+#include "s2/s2cell_id.h"
+#include "io/FileReadBuffer.h"
+#include "io/FileWriteBuffer.h"
+
+const int CELL_LEVELS = S2CellId::kMaxLevel + 1;
+// Levels with fewer probes than this are probed one cell at a time, building a bitmap of the probes to intersect
+// costs more than it saves.
+const uint64_t CELL_LEVEL_INTERSECT_MIN_PROBES = 32;
+
+/*
+ * Cell level bitmaps hold the cells written to the index, one Roaring64 bitmap per S2 level. A cell is stored as its
+ * position along the Hilbert curve at its level, its id shifted right past the level's trailing bits, so cells of the
+ * coarse levels, which are the ancestors probed by every query, fit in 32 bits and a handful of containers. Unlike the
+ * cell filter membership is exact, and levels nothing was written at are answered without reading anything.
+ *
+ * Bitmaps Format
+ * [zero padding to a 32 byte aligned file offset]
+ * [bitmap end uint64 * 31] # end of each level's bitmap relative to the start of the bitmaps, level 0 first
+ * [zero padding to a 32 byte aligned file offset]
+ * [frozen Roaring64 bitmap of each level, each starting 32 byte aligned, levels without cells are empty]
+ */
+class CellLevelBitmapsWriter {
+public:
+    void addCells(std::span<const uint64_t> cellIds);
+
+    // Writes the padding and the bitmaps and returns the number of bytes written.
+    uint64_t writeToFile(FileWriteBuffer &f);
+
+private:
+    std::array<roaring::Roaring64Map, CELL_LEVELS> levels;
+};
+
+// CellLevelBitmapsReader views the bitmaps in the read buffer, lookups may run from several threads at once.
+class CellLevelBitmapsReader {
+public:
+    // pos is the offset the writer started at, before the padding.
+    CellLevelBitmapsReader(FileReadBuffer &f, uint64_t pos, uint64_t size);
+
+    bool contains(uint64_t cellId) const;
+
+    // Appends each of cellIds present in the bitmaps to found. The probes of a level are intersected with the level's
+    // bitmap at once when there are enough of them, cellIds are expected to be sorted and unique.
+    void containsMany(std::span<const uint64_t> cellIds, std::vector<uint64_t> &found) const;
+
+    // Number of cells written at level, counted once when the bitmaps are opened.
+    uint64_t cellCount(int level) const { return cellCounts[level]; };
+
+private:
+    std::vector<roaring::Roaring64Map> levels;
+    std::array<uint64_t, CELL_LEVELS> cellCounts{};
+};
+
+#endif //ROARINGGEOMAPS_CELLLEVELBITMAPS_H
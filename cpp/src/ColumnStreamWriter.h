@@ -0,0 +1,71 @@
+#ifndef ROARINGGEOMAPS_COLUMNSTREAMWRITER_H
+#define ROARINGGEOMAPS_COLUMNSTREAMWRITER_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include "io/FileWriteBuffer.h"
+#include "BlockOffset.h"
+
+// ColumnStreamWriter writes the same column as ByteColumnWriter and RoaringBitmapColumnWriter, the block end offsets
+// followed by the blocks, but writes each block as soon as it is full instead of holding every block until the end.
+// The number of values must be known up front to reserve the block offsets, and the values a block refers to must
+// live until addValue reports the block written.
+template<typename BlockWriterT, typename T>
+class ColumnStreamWriter {
+public:
+    ColumnStreamWriter(FileWriteBuffer &f, uint64_t blockSize, uint64_t valueCount) :
+            f(f), blockSize(blockSize), currentWriteBlock(blockSize),
+            // An empty column still holds one empty block.
+            blockCount(valueCount == 0 ? 1 : (valueCount + blockSize - 1) / blockSize) {
+        f.seek(blockCount * sizeof(uint64_t));
+    }
+
+    // Adds a value of size bytes and returns true when it completed a block, which was written.
+    bool addValue(T value, uint64_t size) {
+        currentWriteBlock.insertValue(std::move(value), size);
+        if (++blockValues < blockSize)
+            return false;
+        writeBlock();
+        return true;
+    }
+
+    // Writes the last block and the block offsets and returns the size of the column.
+    uint64_t finish() {
+        if (blockValues > 0) {
+            writeBlock();
+        } else if (blocksWritten == 0) {
+            blockOffsets.InsertOffset(blockOffset);
+            blocksWritten++;
+        }
+        if (blocksWritten != blockCount) {
+            throw std::runtime_error("column written with a different number of values than reserved");
+        }
+        uint64_t blockOffsetSize = blockCount * sizeof(uint64_t);
+        f.seek(-1 * (blockOffset + blockOffsetSize));
+        blockOffsets.writeToFile(f);
+        f.seek(blockOffset);
+        return blockOffsetSize + blockOffset;
+    }
+
+private:
+    FileWriteBuffer &f;
+    uint64_t blockSize;
+    BlockWriterT currentWriteBlock;
+    uint64_t blockCount;
+    uint64_t blockValues = 0;
+    uint64_t blocksWritten = 0;
+    uint64_t blockOffset = 0;
+    BlockOffsetWriter blockOffsets;
+
+    void writeBlock() {
+        auto blockInfo = currentWriteBlock.WriteBlock(f);
+        blockOffset += blockInfo.first;
+        blockOffsets.InsertOffset(blockOffset);
+        blocksWritten++;
+        currentWriteBlock.clear();
+        blockValues = 0;
+    }
+};
+
+#endif //ROARINGGEOMAPS_COLUMNSTREAMWRITER_H
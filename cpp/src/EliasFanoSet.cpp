@@ -0,0 +1,233 @@
+#include "EliasFanoSet.h"
+#include "endian/endian.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    const uint64_t HEADER_WORDS = 7;
+
+    inline uint64_t loadWord(const char *words, uint64_t index) {
+        uint64_t value;
+        std::memcpy(&value, words + index * sizeof(uint64_t), sizeof(uint64_t));
+        return littleEndian(value);
+    }
+
+    inline void storeWord(char *words, uint64_t index, uint64_t value) {
+        value = littleEndian(value);
+        std::memcpy(words + index * sizeof(uint64_t), &value, sizeof(uint64_t));
+    }
+
+    // Position of the rank-th set bit of word, word must have more than rank bits set.
+    inline uint64_t selectInWord(uint64_t word, uint64_t rank) {
+        uint64_t position = 0;
+        for (uint64_t width = 32; width > 0; width /= 2) {
+            auto count = static_cast<uint64_t>(std::popcount(word & ((uint64_t(1) << width) - 1)));
+            if (rank >= count) {
+                rank -= count;
+                word >>= width;
+                position += width;
+            }
+        }
+        return position;
+    }
+
+    // Position of the rank-th set bit at or after from in words, words are complemented when Zeros is set.
+    template<bool Zeros>
+    uint64_t selectFrom(const char *words, uint64_t from, uint64_t rank) {
+        uint64_t wordIndex = from / 64;
+        uint64_t word = loadWord(words, wordIndex);
+        word = (Zeros ? ~word : word) & (~uint64_t(0) << (from % 64));
+        while (true) {
+            auto count = static_cast<uint64_t>(std::popcount(word));
+            if (rank < count)
+                return wordIndex * 64 + selectInWord(word, rank);
+            rank -= count;
+            word = loadWord(words, ++wordIndex);
+            word = Zeros ? ~word : word;
+        }
+    }
+}
+
+EliasFanoSet EliasFanoSet::build(const std::vector<uint64_t> &values) {
+    uint64_t entries = values.size();
+    // Low bits of floor(log2(max / n)) leave about one value per high bucket.
+    uint64_t lowBits = 0;
+    if (entries > 0 && values.back() / entries > 0)
+        lowBits = 63 - std::countl_zero(values.back() / entries);
+    uint64_t buckets = entries > 0 ? (values.back() >> lowBits) + 1 : 0;
+    uint64_t highBitCount = entries + buckets;
+    uint64_t lowWordCount = (entries * lowBits + 63) / 64;
+    uint64_t highWordCount = (highBitCount + 63) / 64;
+
+    std::vector<uint64_t> low(lowWordCount, 0);
+    std::vector<uint64_t> high(highWordCount, 0);
+    for (uint64_t i = 0; i < entries; ++i) {
+        if (i > 0 && values[i] <= values[i - 1])
+            throw std::invalid_argument("Elias-Fano set values must be sorted and unique");
+        uint64_t position = (values[i] >> lowBits) + i;
+        high[position / 64] |= uint64_t(1) << (position % 64);
+        if (lowBits > 0) {
+            uint64_t lowValue = values[i] & (~uint64_t(0) >> (64 - lowBits));
+            uint64_t offset = i * lowBits;
+            low[offset / 64] |= lowValue << (offset % 64);
+            if (offset % 64 + lowBits > 64)
+                low[offset / 64 + 1] |= lowValue >> (64 - offset % 64);
+        }
+    }
+
+    std::vector<uint64_t> zeros;
+    std::vector<uint64_t> ones;
+    uint64_t zeroCount = 0;
+    uint64_t oneCount = 0;
+    for (uint64_t position = 0; position < highBitCount; ++position) {
+        if (high[position / 64] >> (position % 64) & 1) {
+            if (oneCount++ % ELIAS_FANO_SAMPLE_RATE == 0)
+                ones.push_back(position);
+        } else {
+            if (zeroCount++ % ELIAS_FANO_SAMPLE_RATE == 0)
+                zeros.push_back(position);
+        }
+    }
+
+    EliasFanoSet set;
+    uint64_t words = HEADER_WORDS + lowWordCount + highWordCount + zeros.size() + ones.size();
+    set.storage.resize(words * sizeof(uint64_t));
+    char *data = set.storage.data();
+    uint64_t word = 0;
+    for (auto value: {entries, lowBits, buckets, lowWordCount, highWordCount, uint64_t(zeros.size()),
+                      uint64_t(ones.size())})
+        storeWord(data, word++, value);
+    for (const auto *section: {&low, &high, &zeros, &ones}) {
+        for (auto value: *section)
+            storeWord(data, word++, value);
+    }
+    auto view = EliasFanoSet::view(data, set.storage.size());
+    view.storage = std::move(set.storage);
+    return view;
+}
+
+EliasFanoSet EliasFanoSet::view(const char *data, uint64_t size) {
+    if (size < HEADER_WORDS * sizeof(uint64_t))
+        throw std::runtime_error("Elias-Fano set is truncated");
+    EliasFanoSet set;
+    set.serialized = data;
+    set.serializedSize = size;
+    set.entries = loadWord(data, 0);
+    set.lowBits = loadWord(data, 1);
+    set.buckets = loadWord(data, 2);
+    uint64_t lowWordCount = loadWord(data, 3);
+    uint64_t highWordCount = loadWord(data, 4);
+    uint64_t zeroSampleCount = loadWord(data, 5);
+    uint64_t oneSampleCount = loadWord(data, 6);
+    if ((HEADER_WORDS + lowWordCount + highWordCount + zeroSampleCount + oneSampleCount) * sizeof(uint64_t) > size)
+        throw std::runtime_error("Elias-Fano set is truncated");
+
+    set.lowWords = data + HEADER_WORDS * sizeof(uint64_t);
+    set.highWords = set.lowWords + lowWordCount * sizeof(uint64_t);
+    set.zeroSamples = set.highWords + highWordCount * sizeof(uint64_t);
+    set.oneSamples = set.zeroSamples + zeroSampleCount * sizeof(uint64_t);
+    return set;
+}
+
+uint64_t EliasFanoSet::low(uint64_t index) const {
+    if (lowBits == 0)
+        return 0;
+    uint64_t offset = index * lowBits;
+    uint64_t value = loadWord(lowWords, offset / 64) >> (offset % 64);
+    if (offset % 64 + lowBits > 64)
+        value |= loadWord(lowWords, offset / 64 + 1) << (64 - offset % 64);
+    return value & (~uint64_t(0) >> (64 - lowBits));
+}
+
+uint64_t EliasFanoSet::selectZero(uint64_t rank) const {
+    uint64_t sample = rank / ELIAS_FANO_SAMPLE_RATE;
+    return selectFrom<true>(highWords, loadWord(zeroSamples, sample), rank - sample * ELIAS_FANO_SAMPLE_RATE);
+}
+
+uint64_t EliasFanoSet::selectOne(uint64_t rank) const {
+    uint64_t sample = rank / ELIAS_FANO_SAMPLE_RATE;
+    return selectFrom<false>(highWords, loadWord(oneSamples, sample), rank - sample * ELIAS_FANO_SAMPLE_RATE);
+}
+
+std::pair<uint64_t, uint64_t> EliasFanoSet::bucketRange(uint64_t bucket) const {
+    // The bucket starts after the zero ending the previous bucket and ends at its own zero, the zeros before a position
+    // are the buckets before it so the ones before it are the values before it.
+    uint64_t start = bucket == 0 ? 0 : selectZero(bucket - 1) + 1;
+    uint64_t end = selectFrom<true>(highWords, start, 0);
+    return {start - bucket, end - bucket};
+}
+
+uint64_t EliasFanoSet::searchBucket(uint64_t first, uint64_t end, uint64_t lowValue) const {
+    while (first < end) {
+        uint64_t middle = first + (end - first) / 2;
+        if (low(middle) < lowValue)
+            first = middle + 1;
+        else
+            end = middle;
+    }
+    return first;
+}
+
+bool EliasFanoSet::contains(uint64_t value) const {
+    uint64_t bucket = value >> lowBits;
+    if (bucket >= buckets)
+        return false;
+    uint64_t lowValue = lowBits == 0 ? 0 : value & (~uint64_t(0) >> (64 - lowBits));
+    auto [first, end] = bucketRange(bucket);
+    uint64_t index = searchBucket(first, end, lowValue);
+    return index < end && low(index) == lowValue;
+}
+
+uint64_t EliasFanoSet::lowerBound(uint64_t value, uint64_t &found) const {
+    uint64_t bucket = value >> lowBits;
+    if (bucket >= buckets)
+        return entries;
+    uint64_t lowValue = lowBits == 0 ? 0 : value & (~uint64_t(0) >> (64 - lowBits));
+    auto [first, end] = bucketRange(bucket);
+    uint64_t index = searchBucket(first, end, lowValue);
+    if (index < end) {
+        found = (bucket << lowBits) | low(index);
+    } else if (index < entries) {
+        // Every value of the bucket is less than value, the next value is the first of a later bucket.
+        found = valueAt(index);
+    }
+    return index;
+}
+
+uint64_t EliasFanoSet::lowerBound(uint64_t value, uint64_t &found, Cursor &cursor) const {
+    uint64_t bucket = value >> lowBits;
+    if (bucket >= buckets)
+        return entries;
+    uint64_t lowValue = lowBits == 0 ? 0 : value & (~uint64_t(0) >> (64 - lowBits));
+    uint64_t from = 0;
+    if (cursor.valid && value >= cursor.value && bucket == cursor.bucket) {
+        from = cursor.index;
+    } else if (cursor.valid && value >= cursor.value && bucket - cursor.bucket <= ELIAS_FANO_SAMPLE_RATE) {
+        // The bucket starts after the zero ending the one before it, skip the zeros ending the buckets in between.
+        uint64_t skipped = bucket - cursor.bucket - 1;
+        cursor.start = skipped == 0 ? cursor.end + 1 : selectFrom<true>(highWords, cursor.end + 1, skipped - 1) + 1;
+        cursor.end = selectFrom<true>(highWords, cursor.start, 0);
+    } else {
+        cursor.start = bucket == 0 ? 0 : selectZero(bucket - 1) + 1;
+        cursor.end = selectFrom<true>(highWords, cursor.start, 0);
+    }
+    uint64_t first = cursor.start - bucket;
+    uint64_t end = cursor.end - bucket;
+    uint64_t index = searchBucket(std::max(first, from), end, lowValue);
+    if (index < end) {
+        found = (bucket << lowBits) | low(index);
+    } else if (index < entries) {
+        found = valueAt(index);
+    }
+    cursor.valid = true;
+    cursor.value = value;
+    cursor.bucket = bucket;
+    cursor.index = index;
+    return index;
+}
+
+uint64_t EliasFanoSet::valueAt(uint64_t index) const {
+    return ((selectOne(index) - index) << lowBits) | low(index);
+}
@@ -0,0 +1,101 @@
+#ifndef ROARINGGEOMAPS_ELIASFANOSET_H
+#define ROARINGGEOMAPS_ELIASFANOSET_H
+
+#include <cstdint>
+#include <vector>
+
+// Ones and zeros between select samples of the high bits.
+const uint64_t ELIAS_FANO_SAMPLE_RATE = 64;
+
+/*
+ * EliasFanoSet is a static, exact set of uint64 values, such as cell ids, in about 2 + log2(max / n) bits per value.
+ * Each value is split into its low bits, stored packed, and its high bits, stored as a unary coded bitmap where the
+ * values of high bucket h are a run of ones terminated by the h-th zero. Samples of every ELIAS_FANO_SAMPLE_RATE-th one
+ * and zero locate a bucket, or the i-th value, without reading the bitmap from the start.
+ *
+ * Set Format, every field is little endian uint64
+ * [entries][low bits][buckets][low words][high words][zero samples][one samples]
+ * [low words...]
+ * [high words...]
+ * [zero samples...] # position in the high bits of every ELIAS_FANO_SAMPLE_RATE-th zero
+ * [one samples...]  # position in the high bits of every ELIAS_FANO_SAMPLE_RATE-th one
+ *
+ * A set is a view of its serialized form, either in the read buffer or in memory it owns once built, and is searched
+ * in place.
+ */
+class EliasFanoSet {
+public:
+    EliasFanoSet() = default;
+
+    EliasFanoSet(const EliasFanoSet &) = delete;
+
+    EliasFanoSet &operator=(const EliasFanoSet &) = delete;
+
+    EliasFanoSet(EliasFanoSet &&) = default;
+
+    EliasFanoSet &operator=(EliasFanoSet &&) = default;
+
+    // Builds the set of values, which must be sorted and unique.
+    static EliasFanoSet build(const std::vector<uint64_t> &values);
+
+    // Returns a view of a set serialized at data, data must outlive the set.
+    static EliasFanoSet view(const char *data, uint64_t size);
+
+    // Serialized form of the set.
+    const char *data() const { return serialized; };
+
+    uint64_t sizeInBytes() const { return serializedSize; };
+
+    uint64_t size() const { return entries; };
+
+    bool contains(uint64_t value) const;
+
+    // Index of the first value not less than value, or size() when there is none. When there is one its value is
+    // written to found.
+    uint64_t lowerBound(uint64_t value, uint64_t &found) const;
+
+    // Where a search ended, carried forward to the next search of a batch.
+    struct Cursor {
+        bool valid = false;
+        uint64_t value = 0;  // Value of the last search
+        uint64_t bucket = 0; // High bucket of the last search
+        uint64_t start = 0;  // Position in the high bits of the bucket's first value
+        uint64_t end = 0;    // Position in the high bits of the zero ending the bucket
+        uint64_t index = 0;  // Index returned by the last search
+    };
+
+    // lowerBound for values searched in ascending order. A value in the bucket of the previous search only searches the
+    // bucket from the previous index, and a value a few buckets ahead finds its bucket by scanning forward from the
+    // previous bucket rather than from a select sample. A value less than the previous one starts a new search.
+    uint64_t lowerBound(uint64_t value, uint64_t &found, Cursor &cursor) const;
+
+    uint64_t valueAt(uint64_t index) const;
+
+private:
+    std::vector<char> storage;
+    const char *serialized = nullptr;
+    uint64_t serializedSize = 0;
+
+    uint64_t entries = 0;
+    uint64_t lowBits = 0;
+    uint64_t buckets = 0;
+    const char *lowWords = nullptr;
+    const char *highWords = nullptr;
+    const char *zeroSamples = nullptr;
+    const char *oneSamples = nullptr;
+
+    uint64_t low(uint64_t index) const;
+
+    // Position in the high bits of the rank-th zero or one.
+    uint64_t selectZero(uint64_t rank) const;
+
+    uint64_t selectOne(uint64_t rank) const;
+
+    // Index range [first, end) of the values in high bucket bucket.
+    std::pair<uint64_t, uint64_t> bucketRange(uint64_t bucket) const;
+
+    // First index of [first, end) whose low bits are not less than lowValue.
+    uint64_t searchBucket(uint64_t first, uint64_t end, uint64_t lowValue) const;
+};
+
+#endif //ROARINGGEOMAPS_ELIASFANOSET_H
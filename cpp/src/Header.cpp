@@ -20,7 +20,11 @@
  * [block size uint_16] # A block is the maximum number of rows in 1 block. key and cell indexes are re-indexed via a skip index with a per block entry
  * [levelIndexBucketRange uint_8] # levelIndexBucketRange of the file
  * [file type uint_8] # unused for now value to indicate the file type, this is included to allow future variations of the file format
- * [16 reserved bytes for future use]
+ * [flags uint_8] # bit 0 set when the CellId column has a block index tree, bit 1 set when the cell filter is an
+ *                # Elias-Fano set rather than SuRF. Files written without flags read as 0
+ * [cellLevelBitmaps offset uint64] # at byte 88
+ * [cellLevelBitmaps size uint64] # 0 when the file has no cell level bitmaps
+ * [reserved bytes for future use]
  *
  */
 
@@ -49,7 +53,10 @@ void Header::writeToFile(FileWriteBuffer &buffer) const {
     writeLittleEndianUint8(buffer, levelIndexBucketRange);
     writeLittleEndianUint16(buffer, blockSize);
     writeLittleEndianUint8(buffer, fileType); // Type 1 currently means standard non block compressed format.
-    buffer.write(std::vector<char>(44, 0).data(), 4);
+    writeLittleEndianUint8(buffer, flags);
+    buffer.write(std::vector<char>(44, 0).data(), 3);
+    writeLittleEndianUint64(buffer, cellLevelBitmapsOffset);
+    writeLittleEndianUint64(buffer, cellLevelBitmapsSize);
 }
 
 Header Header::readFromFile(FileReadBuffer &buffer) {
@@ -71,6 +78,9 @@ Header Header::readFromFile(FileReadBuffer &buffer) {
     header.levelIndexBucketRange = readLittleEndianUint8(buffer, 80);
     header.blockSize = readLittleEndianUint16(buffer, 81);
     header.fileType = readLittleEndianUint8(buffer, 83);// Type 1 currently means standard non block compressed format.
+    header.flags = readLittleEndianUint8(buffer, 84);
+    header.cellLevelBitmapsOffset = readLittleEndianUint64(buffer, 88);
+    header.cellLevelBitmapsSize = readLittleEndianUint64(buffer, 96);
     return header;
 }
 
@@ -95,7 +105,7 @@ std::pair<uint64_t, uint64_t> Header::getCellIndexPos() const {
 }
 
 std::pair<uint64_t, uint64_t> Header::getBitmapPos() const {
-    return {roaringIndexOffset, roaringIndexOffset};
+    return {roaringIndexOffset, roaringIndexSize};
 }
 
 void Header::setKeyIndexOffset(uint64_t offset, uint64_t size) {
@@ -113,6 +123,15 @@ void Header::setBitmapOffset(uint64_t offset, uint64_t size) {
     Header::roaringIndexSize = size;
 }
 
+std::pair<uint64_t, uint64_t> Header::getCellLevelBitmapsPos() const {
+    return {cellLevelBitmapsOffset, cellLevelBitmapsSize};
+}
+
+void Header::setCellLevelBitmapsOffset(uint64_t offset, uint64_t size) {
+    Header::cellLevelBitmapsOffset = offset;
+    Header::cellLevelBitmapsSize = size;
+}
+
 uint32_t Header::getKeyIndexEntries() const {
     return keyIndexEntries;
 }
@@ -141,3 +160,24 @@ uint8_t Header::getFileType() const {
     return fileType;
 }
 
+BlockIndexLayout Header::getBlockIndexLayout() const {
+    return flags & HEADER_FLAG_BLOCK_INDEX_BTREE ? BlockIndexLayout::BTree : BlockIndexLayout::Sorted;
+}
+
+void Header::setBlockIndexLayout(BlockIndexLayout layout) {
+    if (layout == BlockIndexLayout::BTree)
+        flags |= HEADER_FLAG_BLOCK_INDEX_BTREE;
+    else
+        flags &= ~HEADER_FLAG_BLOCK_INDEX_BTREE;
+}
+
+CellFilterType Header::getCellFilterType() const {
+    return flags & HEADER_FLAG_CELL_FILTER_ELIAS_FANO ? CellFilterType::EliasFano : CellFilterType::SuRF;
+}
+
+void Header::setCellFilterType(CellFilterType type) {
+    if (type == CellFilterType::EliasFano)
+        flags |= HEADER_FLAG_CELL_FILTER_ELIAS_FANO;
+    else
+        flags &= ~HEADER_FLAG_CELL_FILTER_ELIAS_FANO;
+}
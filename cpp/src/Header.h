@@ -8,6 +8,24 @@
 
 const uint32_t HEADER_SIZE = 128; // Header is 32 byte aligned to allow for use with frozen bitmaps.
 
+// Layout of the CellId column's block index. Sorted is the sorted array of block maxima only, BTree adds a static B+tree
+// over it after the CellId blocks.
+enum class BlockIndexLayout : uint8_t {
+    Sorted = 0,
+    BTree = 1
+};
+
+// Implementation of the cell filter. SuRF is a succinct trie over the cell ids as strings, it is small but reports
+// false positives. EliasFano is an exact Elias-Fano coded set searched directly on the uint64 cell ids.
+enum class CellFilterType : uint8_t {
+    SuRF = 0,
+    EliasFano = 1
+};
+
+// Header flag bits.
+const uint8_t HEADER_FLAG_BLOCK_INDEX_BTREE = 1;
+const uint8_t HEADER_FLAG_CELL_FILTER_ELIAS_FANO = 2;
+
 class Header {
 public:
 
@@ -35,6 +53,11 @@ public:
 
     void setBitmapOffset(uint64_t offset, uint64_t size);
 
+    // Offset and size of the cell level bitmaps, the size is 0 for files written without them.
+    std::pair<uint64_t, uint64_t> getCellLevelBitmapsPos() const;
+
+    void setCellLevelBitmapsOffset(uint64_t offset, uint64_t size);
+
     uint32_t getKeyIndexEntries() const;
 
     void setKeyIndexEntries(uint32_t size);
@@ -55,20 +78,31 @@ public:
 
     void setFileType(uint8_t fileType);
 
+    BlockIndexLayout getBlockIndexLayout() const;
+
+    void setBlockIndexLayout(BlockIndexLayout layout);
+
+    CellFilterType getCellFilterType() const;
+
+    void setCellFilterType(CellFilterType type);
+
 private:
     uint64_t cellIdFilterOffset = 0;
     uint64_t cellIdFilterSize = 0;
     uint64_t keyIndexOffset = 0;
-    uint32_t keyIndexSize = 0;
+    uint64_t keyIndexSize = 0;
     uint64_t cellIndexOffset = 0;
     uint64_t cellIndexSize = 0;
     uint64_t roaringIndexOffset = 0;
     uint64_t roaringIndexSize = 0;
+    uint64_t cellLevelBitmapsOffset = 0;
+    uint64_t cellLevelBitmapsSize = 0;
     uint32_t keyIndexEntries = 0;
     uint32_t cellIndexEntries = 0;
     uint8_t levelIndexBucketRange = 1;
     uint16_t blockSize;
     uint8_t fileType;
+    uint8_t flags = 0;
 };
 
 #endif // ROARINGGEOMAPS_HEADER_H
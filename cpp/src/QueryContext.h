@@ -0,0 +1,142 @@
+#ifndef ROARINGGEOMAPS_QUERYCONTEXT_H
+#define ROARINGGEOMAPS_QUERYCONTEXT_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "roaring.hh"
+#include "s2/s2cell_id.h"
+#include "S2BlockIndexReader.h"
+#include "RoaringBitmapColumnReader.h"
+#include "QueryPlanner.h"
+#include "QueryStats.h"
+
+// QueryResults holds the key ids found by a query and a view of each key. Keys are not copied, the views point into
+// the key column of the reader's read buffer and are valid for as long as the reader is.
+class QueryResults {
+public:
+    using const_iterator = std::vector<std::string_view>::const_iterator;
+
+    size_t size() const { return keys.size(); };
+
+    bool empty() const { return keys.empty(); };
+
+    std::string_view operator[](size_t i) const { return keys[i]; };
+
+    // Id of the key at i, the position of the key in the index's key column.
+    uint32_t keyId(size_t i) const { return keyIds[i]; };
+
+    const_iterator begin() const { return keys.begin(); };
+
+    const_iterator end() const { return keys.end(); };
+
+    bool operator==(const QueryResults &other) const { return keys == other.keys; };
+
+private:
+    friend class RoaringGeoMapReader;
+    friend class QueryContext;
+
+    std::vector<uint32_t> keyIds;
+    std::vector<std::string_view> keys;
+
+    void clear() {
+        keyIds.clear();
+        keys.clear();
+    };
+
+    void append(uint32_t keyId, std::string_view key) {
+        keyIds.emplace_back(keyId);
+        keys.emplace_back(key);
+    };
+};
+
+// QueryContext is the scratch space of a query. A context can be reused by any number of queries but only by one at a
+// time, typically one context per thread. Its vectors are cleared rather than freed between queries, so once they have
+// grown to fit the largest query the query path does not allocate, other than within the cell filter and the roaring
+// union of the result.
+class QueryContext {
+public:
+    QueryContext() = default;
+
+    QueryContext(const QueryContext &) = delete;
+
+    QueryContext &operator=(const QueryContext &) = delete;
+
+    QueryContext(QueryContext &&) = default;
+
+    QueryContext &operator=(QueryContext &&) = default;
+
+    // Keys found by the last query run with this context, replaced by the next query run with it.
+    const QueryResults &results() const { return queryResults; };
+
+    // Plan of the last Contains query run with this context.
+    const QueryPlan &plan() const { return queryPlan; };
+
+private:
+    friend class RoaringGeoMapReader;
+
+    // Query cells denormalized to the levels of the index.
+    std::vector<S2CellId> queryCells;
+    // Child ranges of the query cells and their distinct ancestors, probed in the cell filter.
+    std::vector<std::pair<uint64_t, uint64_t>> rangeProbes;
+    std::vector<uint64_t> ancestorProbes;
+    // Child ranges and ancestors found in the cell filter, sorted before planning.
+    std::vector<std::pair<uint64_t, uint64_t>> cellRanges;
+    std::vector<uint64_t> cellAncestors;
+    QueryPlan queryPlan;
+    std::vector<S2BlockValues<uint64_t>> blockPlan;
+    // Matches within the CellId block being read.
+    std::vector<uint32_t> indexes;
+    std::vector<std::pair<uint32_t, uint32_t>> indexRanges;
+    // Bitmaps of every matched cell, the blocks holding them are kept alive until the next query.
+    std::vector<std::shared_ptr<const DecodedBitmapBlock>> bitmapBlocks;
+    std::vector<const roaring::Roaring *> bitmaps;
+    roaring::Roaring keyIds;
+    QueryResults queryResults;
+    // Scratch space of each partition of the blocks when the query runs on an executor.
+    std::vector<QueryContext> partitions;
+    // Counters of the query, stages are only timed when timeStages is set.
+    QueryStats stats;
+    bool timeStages = false;
+    std::chrono::steady_clock::time_point stageStart;
+
+    void startStages(bool timed) {
+        timeStages = timed;
+        if (timeStages)
+            stageStart = std::chrono::steady_clock::now();
+    };
+
+    // Adds the time since the previous stage ended to stageNanos.
+    void endStage(uint64_t &stageNanos) {
+        if (!timeStages)
+            return;
+        auto now = std::chrono::steady_clock::now();
+        stageNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(now - stageStart).count();
+        stageStart = now;
+    };
+
+    void clear() {
+        queryCells.clear();
+        rangeProbes.clear();
+        ancestorProbes.clear();
+        cellRanges.clear();
+        cellAncestors.clear();
+        queryPlan = {};
+        blockPlan.clear();
+        indexes.clear();
+        indexRanges.clear();
+        bitmapBlocks.clear();
+        bitmaps.clear();
+        queryResults.clear();
+        stats = {};
+        timeStages = false;
+        for (auto &partition: partitions)
+            partition.clear();
+    };
+};
+
+#endif //ROARINGGEOMAPS_QUERYCONTEXT_H
@@ -0,0 +1,46 @@
+#include "QueryCursor.h"
+#include <algorithm>
+
+QueryCursor::QueryCursor(const ByteColumnReader &keyColumn, uint32_t blockSize, roaring::Roaring keyIds, uint64_t offset,
+                         uint64_t limit) :
+        keyColumn(&keyColumn),
+        blockSize(blockSize),
+        keyIds(std::move(keyIds)) {
+    uint64_t cardinality = this->keyIds.cardinality();
+    position = std::min(offset, cardinality);
+    endPosition = cardinality - position < limit ? cardinality : position + limit;
+}
+
+bool QueryCursor::next() {
+    if (bufferedIndex == bufferedKeyIds.size()) {
+        if (position >= endPosition)
+            return false;
+        // Take up to a block's worth of key ids at a time, the key ids of a large result are never all decoded.
+        uint64_t count = std::min<uint64_t>(blockSize, endPosition - position);
+        bufferedKeyIds.resize(count);
+        keyIds.rangeUint32Array(bufferedKeyIds.data(), position, count);
+        position += count;
+        bufferedIndex = 0;
+    }
+
+    currentKeyId = bufferedKeyIds[bufferedIndex++];
+    uint32_t keyBlockId = currentKeyId / blockSize;
+    if (!block || keyBlockId != blockId) {
+        block.emplace(keyColumn->ReadBlock(keyBlockId));
+        blockId = keyBlockId;
+    }
+    currentKey = block->readView(currentKeyId - (keyBlockId * blockSize));
+    return true;
+}
+
+std::string_view QueryCursor::key() const {
+    return currentKey;
+}
+
+uint32_t QueryCursor::keyId() const {
+    return currentKeyId;
+}
+
+uint64_t QueryCursor::totalCount() const {
+    return keyIds.cardinality();
+}
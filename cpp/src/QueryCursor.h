@@ -0,0 +1,52 @@
+#ifndef ROARINGGEOMAPS_QUERYCURSOR_H
+#define ROARINGGEOMAPS_QUERYCURSOR_H
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "roaring.hh"
+#include "ByteColumnReader.h"
+
+// QueryCursor streams the keys of a query in key id order. Key ids are taken from the query's key id bitmap a block at
+// a time and a key block is only opened once the cursor reaches a key in it, so a cursor stopped early by its limit
+// (or by the caller) does not read the remaining keys. Keys are views into the index and a cursor must not outlive the
+// reader that created it.
+//
+//  auto cursor = reader.ContainsCursor(cells, 0, 20);
+//  while (cursor.next())
+//      use(cursor.key());
+class QueryCursor {
+public:
+    // Advances to the next key, returns false once the limit or the end of the results is reached.
+    bool next();
+
+    // Key and key id the cursor is at, only valid after next returned true.
+    std::string_view key() const;
+
+    uint32_t keyId() const;
+
+    // Number of keys matching the query, ignoring offset and limit.
+    uint64_t totalCount() const;
+
+private:
+    friend class RoaringGeoMapReader;
+
+    QueryCursor(const ByteColumnReader &keyColumn, uint32_t blockSize, roaring::Roaring keyIds, uint64_t offset,
+                uint64_t limit);
+
+    const ByteColumnReader *keyColumn;
+    uint32_t blockSize;
+    roaring::Roaring keyIds;
+    // Rank of the next key id to take from keyIds and the rank the cursor stops at.
+    uint64_t position;
+    uint64_t endPosition;
+    std::vector<uint32_t> bufferedKeyIds;
+    size_t bufferedIndex = 0;
+    std::optional<BytesBlockReader> block;
+    uint32_t blockId = 0;
+    uint32_t currentKeyId = 0;
+    std::string_view currentKey;
+};
+
+#endif //ROARINGGEOMAPS_QUERYCURSOR_H
@@ -0,0 +1,98 @@
+#include "QueryExecutor.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+QueryExecutor::QueryExecutor(unsigned threads) {
+    workers.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i)
+        workers.emplace_back([this] { workerLoop(); });
+}
+
+QueryExecutor::~QueryExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (auto &worker: workers)
+        worker.join();
+}
+
+unsigned QueryExecutor::concurrency() const {
+    return workers.size() + 1;
+}
+
+void QueryExecutor::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void QueryExecutor::parallelFor(size_t n, const std::function<void(size_t)> &task) {
+    if (n == 0)
+        return;
+
+    // State is shared with the helper jobs, a helper dequeued after the loop finished finds no index left and only
+    // touches the state, which it keeps alive.
+    struct State {
+        const std::function<void(size_t)> *task;
+        size_t n;
+        std::atomic<size_t> next = 0;
+        size_t finished = 0;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<State>();
+    state->task = &task;
+    state->n = n;
+
+    auto run = [](State &s) {
+        size_t completed = 0;
+        std::exception_ptr error;
+        for (size_t i = s.next.fetch_add(1); i < s.n; i = s.next.fetch_add(1)) {
+            try {
+                (*s.task)(i);
+            } catch (...) {
+                if (!error)
+                    error = std::current_exception();
+            }
+            ++completed;
+        }
+        if (completed == 0)
+            return;
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (error && !s.error)
+            s.error = error;
+        s.finished += completed;
+        if (s.finished == s.n)
+            s.done.notify_all();
+    };
+
+    size_t helpers = std::min<size_t>(workers.size(), n - 1);
+    if (helpers > 0) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < helpers; ++i)
+                jobs.emplace_back([state, run] { run(*state); });
+        }
+        jobAvailable.notify_all();
+    }
+
+    run(*state);
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&] { return state->finished == state->n; });
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
@@ -0,0 +1,44 @@
+#ifndef ROARINGGEOMAPS_QUERYEXECUTOR_H
+#define ROARINGGEOMAPS_QUERYEXECUTOR_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// QueryExecutor is a fixed pool of worker threads used to split a single large query across cores. An executor can be
+// shared by any number of readers and queries.
+class QueryExecutor {
+public:
+    // Creates an executor with threads workers, the thread calling parallelFor also runs tasks.
+    explicit QueryExecutor(unsigned threads = std::thread::hardware_concurrency());
+
+    ~QueryExecutor();
+
+    QueryExecutor(const QueryExecutor &) = delete;
+
+    QueryExecutor &operator=(const QueryExecutor &) = delete;
+
+    // Number of threads running the tasks of a parallelFor, the workers and the caller.
+    unsigned concurrency() const;
+
+    // Runs task(i) for every i in [0, n) and returns once all have finished. Indexes are handed out one at a time to
+    // the workers and the calling thread, so uneven tasks balance across threads. The calling thread works through the
+    // indexes itself, a parallelFor called from a task completes even when every worker is busy. The first exception
+    // thrown by a task is rethrown once the remaining tasks have finished.
+    void parallelFor(size_t n, const std::function<void(size_t)> &task);
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    bool stopping = false;
+
+    void workerLoop();
+};
+
+#endif //ROARINGGEOMAPS_QUERYEXECUTOR_H
@@ -0,0 +1,65 @@
+#include "QueryPlanner.h"
+#include <algorithm>
+
+const char *queryStrategyName(QueryStrategy strategy) {
+    switch (strategy) {
+        case QueryStrategy::Auto:
+            return "auto";
+        case QueryStrategy::FilterProbe:
+            return "filter probe";
+        case QueryStrategy::BlockIndex:
+            return "block index";
+        case QueryStrategy::Scan:
+            return "scan";
+    }
+    return "unknown";
+}
+
+QueryPlanner::QueryPlanner(uint64_t cells, uint32_t blockSize, CellFilterType filterType,
+                           const std::array<uint64_t, CELL_LEVELS> &cellsPerLevel) :
+        cells(cells), blockSize(std::max<uint32_t>(blockSize, 1)),
+        rangeProbeCost(filterType == CellFilterType::EliasFano ? ELIAS_FANO_RANGE_PROBE_NS : SURF_RANGE_PROBE_NS) {
+    uint64_t finer = 0;
+    for (int level = S2CellId::kMaxLevel; level >= 0; --level) {
+        finer += cellsPerLevel[level];
+        finerFraction[level] = cells > 0 ? static_cast<double>(finer) / static_cast<double>(cells) : 0;
+    }
+}
+
+void QueryPlanner::choose(std::span<const S2CellId> queryCells, uint64_t spanStart, uint64_t spanEnd,
+                          uint64_t spanBlocks, QueryPlan &plan) const {
+    plan.costBased = true;
+    plan.spanBlocks = spanBlocks;
+    auto spanCells = static_cast<double>(std::min<uint64_t>(cells, spanBlocks * blockSize));
+    double spanLength = static_cast<double>(spanEnd - spanStart) + 1;
+
+    // Blocks read for the child ranges, when every range is planned and when only the ranges the filter finds are.
+    double rangeBlocks = 0;
+    double foundRangeBlocks = 0;
+    double foundRanges = 0;
+    plan.estimatedRangeCells = 0;
+    for (auto cellId: queryCells) {
+        double rangeLength = static_cast<double>(cellId.range_max().id() - cellId.range_min().id()) + 1;
+        double rangeCells = spanCells * std::min(1.0, rangeLength / spanLength) * finerFraction[cellId.level()];
+        plan.estimatedRangeCells += rangeCells;
+        rangeBlocks += 1 + rangeCells / blockSize;
+        foundRanges += std::min(1.0, rangeCells);
+        foundRangeBlocks += std::min(1.0, rangeCells) + rangeCells / blockSize;
+    }
+    auto ancestors = static_cast<double>(plan.ancestorsFound);
+    auto span = static_cast<double>(spanBlocks);
+    double blocks = std::min(span, rangeBlocks + ancestors);
+    double foundBlocks = std::min(span, foundRangeBlocks + ancestors);
+    auto queryCellCount = static_cast<double>(queryCells.size());
+
+    plan.filterProbeCost = queryCellCount * rangeProbeCost + (foundRanges + ancestors) * BLOCK_SEARCH_NS +
+                           foundBlocks * BLOCK_READ_NS;
+    plan.blockIndexCost = (queryCellCount + ancestors) * BLOCK_SEARCH_NS + blocks * BLOCK_READ_NS;
+    plan.scanCost = BLOCK_SEARCH_NS + span * BLOCK_SCAN_NS + blocks * BLOCK_READ_NS;
+
+    plan.strategy = QueryStrategy::FilterProbe;
+    if (plan.blockIndexCost < plan.filterProbeCost)
+        plan.strategy = QueryStrategy::BlockIndex;
+    if (plan.scanCost < std::min(plan.filterProbeCost, plan.blockIndexCost))
+        plan.strategy = QueryStrategy::Scan;
+}
@@ -0,0 +1,82 @@
+#ifndef ROARINGGEOMAPS_QUERYPLANNER_H
+#define ROARINGGEOMAPS_QUERYPLANNER_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include "s2/s2cell_id.h"
+#include "CellLevelBitmaps.h"
+#include "Header.h"
+
+// How a Contains query finds the CellId blocks to read.
+// - FilterProbe probes the cell filter for the child range of every query cell and plans only the ranges found.
+// - BlockIndex skips the cell filter and plans every child range through block index searches.
+// - Scan skips the cell filter and plans every child range with one search followed by a linear merge of the query
+//   with the block index.
+// Ancestors are probed in the cell level bitmaps, or the cell filter for files without them, by every strategy.
+enum class QueryStrategy : uint8_t {
+    Auto,
+    FilterProbe,
+    BlockIndex,
+    Scan
+};
+
+const char *queryStrategyName(QueryStrategy strategy);
+
+// Estimated cost in nanoseconds of the operations a strategy is made of. The estimates only need to be right relative
+// to each other.
+const double SURF_RANGE_PROBE_NS = 600;
+const double ELIAS_FANO_RANGE_PROBE_NS = 350;
+// Searching the block index and then the block for a range or value.
+const double BLOCK_SEARCH_NS = 80;
+// Opening a CellId block and its bitmap block, and unioning the bitmaps of a few cells.
+const double BLOCK_READ_NS = 1500;
+// Stepping past a block in a linear merge.
+const double BLOCK_SCAN_NS = 4;
+
+// QueryPlan is the plan of a Contains query, the strategy chosen and the estimates it was chosen from.
+struct QueryPlan {
+    QueryStrategy strategy = QueryStrategy::FilterProbe;
+    // Set when the strategy was chosen from the estimated costs, rather than forced by the reader's options or used by
+    // default for lack of statistics.
+    bool costBased = false;
+    uint64_t queryCells = 0;
+    uint64_t ancestorProbes = 0;
+    uint64_t ancestorsFound = 0;
+    // Blocks from the block of the first query cell to the block of the last.
+    uint64_t spanBlocks = 0;
+    // Indexed cells estimated to be within the child ranges of the query cells.
+    double estimatedRangeCells = 0;
+    // Estimated nanoseconds of each strategy, 0 when the strategy was not chosen by cost.
+    double filterProbeCost = 0;
+    double blockIndexCost = 0;
+    double scanCost = 0;
+    // Blocks planned to be read.
+    uint64_t blocksPlanned = 0;
+};
+
+// QueryPlanner estimates the cost of each strategy from the statistics of the index: the number of cells, the cells
+// per block and the cells written at each level, read from the cell level bitmaps. The span of a query is the blocks
+// from the block of its first cell id to the block of its last, each query cell is assumed to hold indexed cells at the
+// average density of the span.
+class QueryPlanner {
+public:
+    QueryPlanner() = default;
+
+    QueryPlanner(uint64_t cells, uint32_t blockSize, CellFilterType filterType,
+                 const std::array<uint64_t, CELL_LEVELS> &cellsPerLevel);
+
+    // Fills in the estimates and the strategy of plan, whose query cell and ancestor counts are already set. The span
+    // is spanBlocks blocks holding the cell ids from spanStart to spanEnd.
+    void choose(std::span<const S2CellId> queryCells, uint64_t spanStart, uint64_t spanEnd, uint64_t spanBlocks,
+                QueryPlan &plan) const;
+
+private:
+    uint64_t cells = 0;
+    uint32_t blockSize = 1;
+    double rangeProbeCost = SURF_RANGE_PROBE_NS;
+    // Fraction of the indexed cells at each level or finer, the cells a query cell of the level can hold.
+    std::array<double, CELL_LEVELS> finerFraction{};
+};
+
+#endif //ROARINGGEOMAPS_QUERYPLANNER_H
@@ -0,0 +1,38 @@
+#ifndef ROARINGGEOMAPS_QUERYSTATS_H
+#define ROARINGGEOMAPS_QUERYSTATS_H
+
+#include <cstdint>
+
+// QueryStats reports the work done by a single query and the time spent in each of its stages. Counters cover the
+// whole query, including the partitions of a query run on an executor, stages are wall clock time on the calling
+// thread.
+struct QueryStats {
+    // Query cells once denormalized to the levels of the index.
+    uint64_t queryCells = 0;
+    // Probes of the cell filter and the cell level bitmaps, for child ranges and ancestors.
+    uint64_t filterProbes = 0;
+    uint64_t rangesFound = 0;
+    uint64_t ancestorsFound = 0;
+    uint64_t blocksPlanned = 0;
+    // Entries of the CellId blocks searched.
+    uint64_t cellIdEntriesScanned = 0;
+    // Bitmaps of matching cells unioned into the result, and the number of those decoded by this query rather than
+    // found already decoded in the block cache.
+    uint64_t bitmapsRead = 0;
+    uint64_t bitmapsDecoded = 0;
+    uint64_t unionCardinality = 0;
+    uint64_t keyBlocksRead = 0;
+    // Bytes of the CellId, bitmap and key blocks read.
+    uint64_t bytesTouched = 0;
+
+    uint64_t denormalizeNanos = 0;
+    uint64_t filterNanos = 0;
+    // Choosing the strategy and planning the blocks to read.
+    uint64_t planNanos = 0;
+    // Reading the planned blocks and collecting the bitmaps of the matching cells.
+    uint64_t blockProbeNanos = 0;
+    uint64_t unionNanos = 0;
+    uint64_t keyFetchNanos = 0;
+};
+
+#endif //ROARINGGEOMAPS_QUERYSTATS_H
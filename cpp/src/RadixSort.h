@@ -0,0 +1,50 @@
+#ifndef ROARINGGEOMAPS_RADIXSORT_H
+#define ROARINGGEOMAPS_RADIXSORT_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+const int RADIX_BITS = 8;
+const int RADIX_BUCKETS = 1 << RADIX_BITS;
+const int RADIX_DIGITS = 64 / RADIX_BITS;
+
+// Sorts values by the uint64 key(value) with a stable least significant digit radix sort, values with equal keys keep
+// their order. The histograms of every digit are counted in a single pass and digits equal across all values, such as
+// the high bits of keys spanning a small range, are skipped. scratch is resized to the size of values and left with
+// unspecified contents, passing the same scratch to several sorts avoids reallocating it.
+template<typename T, typename Key>
+void radixSort(std::vector<T> &values, std::vector<T> &scratch, Key key) {
+    std::vector<std::array<uint64_t, RADIX_BUCKETS>> counts(RADIX_DIGITS);
+    for (const auto &value: values) {
+        uint64_t k = key(value);
+        for (int digit = 0; digit < RADIX_DIGITS; ++digit)
+            counts[digit][(k >> (digit * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+    }
+
+    scratch.resize(values.size());
+    for (int digit = 0; digit < RADIX_DIGITS; ++digit) {
+        auto &digitCounts = counts[digit];
+        bool skip = false;
+        for (auto count: digitCounts) {
+            if (count == values.size()) {
+                skip = true;
+                break;
+            }
+        }
+        if (skip)
+            continue;
+
+        uint64_t offset = 0;
+        for (auto &count: digitCounts) {
+            uint64_t bucketSize = count;
+            count = offset;
+            offset += bucketSize;
+        }
+        for (const auto &value: values)
+            scratch[digitCounts[(key(value) >> (digit * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++] = value;
+        values.swap(scratch);
+    }
+}
+
+#endif //ROARINGGEOMAPS_RADIXSORT_H
@@ -7,11 +7,53 @@ RoaringBitmapColumnReader::RoaringBitmapColumnReader(FileReadBuffer &f, uint64_t
         size(size),
         entries(entries),
         blockSize(blockSize),
-        blockOffset(f, startPos, determineBlocks(blockSize, entries)) {}
+        blockOffset(f, startPos, determineBlocks(blockSize, entries)) {
+    f.advise(dataPos(), size - blockOffset.sizeOf(), FileReadBuffer::Advice::Random);
+    f.advise(startPos, blockOffset.sizeOf(), FileReadBuffer::Advice::WillNeed);
+}
 
-RoaringBitmapBlockReader RoaringBitmapColumnReader::ReadBlock(uint32_t block) {
+RoaringBitmapBlockReader RoaringBitmapColumnReader::ReadBlock(uint32_t block) const {
     auto [start, sizeOf] = blockOffset.BlockPos(block);
     uint32_t blockEntries = (block + 1) * blockSize <= entries ? blockSize : entries % blockSize;
     return RoaringBitmapBlockReader(f, dataPos() + start, sizeOf, blockEntries);
 };
 
+
+DecodedBitmapBlock::DecodedBitmapBlock(RoaringBitmapBlockReader reader) :
+        reader(std::move(reader)),
+        decoded(std::make_unique<std::once_flag[]>(this->reader.entryCount())),
+        bitmaps(std::make_unique<std::optional<roaring::Roaring>[]>(this->reader.entryCount())) {}
+
+const roaring::Roaring &DecodedBitmapBlock::bitmap(uint32_t index) const {
+    if (index >= reader.entryCount()) {
+        throw std::out_of_range("Bitmap index out of bounds");
+    }
+    std::call_once(decoded[index], [&] { bitmaps[index].emplace(reader.readIndex(index)); });
+    return *bitmaps[index];
+}
+
+const roaring::Roaring &DecodedBitmapBlock::bitmap(uint32_t index, uint64_t &decodes) const {
+    if (index >= reader.entryCount()) {
+        throw std::out_of_range("Bitmap index out of bounds");
+    }
+    std::call_once(decoded[index], [&] {
+        bitmaps[index].emplace(reader.readIndex(index));
+        ++decodes;
+    });
+    return *bitmaps[index];
+}
+
+uint64_t DecodedBitmapBlock::entryCount() const {
+    return reader.entryCount();
+}
+
+uint64_t DecodedBitmapBlock::sizeOf() const {
+    return reader.sizeOf();
+}
+
+uint64_t DecodedBitmapBlock::sizeInBytes() const {
+    // Frozen views reference the containers in the read buffer, the decoded size is dominated by the container headers
+    // which are bounded by the size of the block in the file.
+    return sizeof(DecodedBitmapBlock) + reader.sizeOf() +
+           reader.entryCount() * (sizeof(std::once_flag) + sizeof(std::optional<roaring::Roaring>));
+}
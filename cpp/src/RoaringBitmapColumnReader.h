@@ -4,23 +4,53 @@
 #include "BlockOffset.h"
 #include "Block.h"
 #include "roaring.hh"
+#include <memory>
+#include <mutex>
+#include <optional>
 
-class RoaringBitmapBlockReader : public BlockReader<std::unique_ptr<roaring::Roaring>> {
+// Bitmaps are frozen views over the read buffer, their containers are not copied and they must not outlive the buffer.
+class RoaringBitmapBlockReader : public BlockReader<roaring::Roaring> {
 public:
     explicit RoaringBitmapBlockReader(FileReadBuffer &f, uint64_t position, uint64_t size, uint32_t entries) :
-            BlockReader<std::unique_ptr<roaring::Roaring>>(f, position, size, entries) {};
+            BlockReader<roaring::Roaring>(f, position, size, entries, FROZEN_BITMAP_ALIGNMENT) {};
 
-    std::unique_ptr<roaring::Roaring> readValue(FileReadBuffer &f, uint64_t position, uint64_t size) override {
-        return std::make_unique<roaring::Roaring>(roaring::Roaring::read(f.view(position, size), false));
+    roaring::Roaring readValue(FileReadBuffer &f, uint64_t position, uint64_t size) override {
+        return roaring::Roaring::frozenView(f.view(position, size), size);
     };
 };
 
+// DecodedBitmapBlock decodes the bitmaps of a block on first access and keeps them for the lifetime of the block, so
+// a block held in the block cache creates the frozen view of each bitmap at most once. Bitmaps may be read from
+// several threads at once.
+class DecodedBitmapBlock {
+public:
+    explicit DecodedBitmapBlock(RoaringBitmapBlockReader reader);
+
+    const roaring::Roaring &bitmap(uint32_t index) const;
+
+    // bitmap, counting the call in decodes when it is the one decoding the bitmap.
+    const roaring::Roaring &bitmap(uint32_t index, uint64_t &decodes) const;
+
+    uint64_t entryCount() const;
+
+    // Size of the block in the file in bytes.
+    uint64_t sizeOf() const;
+
+    // Approximate memory held by the block once every bitmap is decoded, used as its block cache cost.
+    uint64_t sizeInBytes() const;
+
+private:
+    mutable RoaringBitmapBlockReader reader;
+    std::unique_ptr<std::once_flag[]> decoded;
+    std::unique_ptr<std::optional<roaring::Roaring>[]> bitmaps;
+};
+
 class RoaringBitmapColumnReader {
 public:
     RoaringBitmapColumnReader(FileReadBuffer &f, uint64_t startPos, uint64_t size, uint32_t entries,
                               uint16_t blockSize);
 
-    RoaringBitmapBlockReader ReadBlock(uint32_t blockIndex);
+    RoaringBitmapBlockReader ReadBlock(uint32_t blockIndex) const;
 
 private:
     FileReadBuffer &f;
@@ -30,7 +60,7 @@ private:
     uint32_t entries;
     uint64_t blockSize;
 
-    inline uint64_t dataPos() {
+    inline uint64_t dataPos() const {
         return startPos + blockOffset.sizeOf();
     }
 };
@@ -2,20 +2,21 @@
 #include "WriteHelpers.h"
 #include "Block.h"
 #include "BlockOffset.h"
+#include "QueryExecutor.h"
 
 RoaringBitmapColumnWriter::RoaringBitmapColumnWriter(uint64_t blockSize) : blockSize(blockSize),
                                                                            currentWriteBlock(blockSize) {}
 
 void RoaringBitmapColumnWriter::addBitmap(roaring::Roaring *bitmap) {
-    bool blockComplete = !currentWriteBlock.insertValue(bitmap, bitmap->getSizeInBytes(false));
+    bool blockComplete = !currentWriteBlock.insertValue(bitmap, bitmap->getFrozenSizeInBytes());
     if (blockComplete) {
         blocks.push_back(std::move(currentWriteBlock));
         currentWriteBlock = RoaringBitMapBlockWriter(blockSize);
-        currentWriteBlock.insertValue(bitmap, bitmap->getSizeInBytes(false));
+        currentWriteBlock.insertValue(bitmap, bitmap->getFrozenSizeInBytes());
     }
 }
 
-uint64_t RoaringBitmapColumnWriter::writeToFile(FileWriteBuffer &f) {
+uint64_t RoaringBitmapColumnWriter::writeToFile(FileWriteBuffer &f, QueryExecutor *executor, uint64_t batchSize) {
     // 0. push current block which is not yet in blocks vector;
     blocks.push_back(std::move(currentWriteBlock));
     // 1. Reserve space for block index and block Index by seeking to write position beyond position for these 2 values
@@ -24,16 +25,38 @@ uint64_t RoaringBitmapColumnWriter::writeToFile(FileWriteBuffer &f) {
     // 2. write each block;
     BlockOffsetWriter blockOffsets;
     uint64_t blockOffset = 0;
-    for (auto block: blocks) {
-        auto blockInfo = block.WriteBlock(f);
-        blockOffset += blockInfo.first;
-        blockOffsets.InsertOffset(blockOffset);
+    if (executor == nullptr) {
+        for (auto &block: blocks) {
+            auto blockInfo = block.WriteBlock(f);
+            blockOffset += blockInfo.first;
+            blockOffsets.InsertOffset(blockOffset);
+        }
+    } else {
+        // A block's position only depends on the sizes of the blocks before it. Blocks are serialized a batch at a
+        // time into the space the batch reserves in the write buffer, which bounds the memory held by the buffer.
+        uint64_t blocksStart = f.offset();
+        std::vector<uint64_t> blockStarts(blocks.size() + 1);
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            blockStarts[i] = blocksStart + blockOffset;
+            blockOffset += blocks[i].sizeAt(blockStarts[i]);
+            blockOffsets.InsertOffset(blockOffset);
+        }
+        blockStarts[blocks.size()] = blocksStart + blockOffset;
+        for (size_t batchStart = 0, batchEnd; batchStart < blocks.size(); batchStart = batchEnd) {
+            batchEnd = batchStart + 1;
+            while (batchEnd < blocks.size() && blockStarts[batchEnd + 1] - blockStarts[batchStart] <= batchSize)
+                ++batchEnd;
+            f.seek(blockStarts[batchEnd] - blockStarts[batchStart]);
+            executor->parallelFor(batchEnd - batchStart, [&](size_t i) {
+                blocks[batchStart + i].WriteBlockAt(f, blockStarts[batchStart + i]);
+            });
+        }
     }
     // 3. seek back to the start of buffer and write block index and block offset
     f.seek(-1 * (blockOffset + blockOffsetSize));
     blockOffsets.writeToFile(f);
     // 4. seek back to the next write position which is the end of the block data.
-    f.seek(blockOffset + blockOffsetSize);
+    f.seek(blockOffset);
     // 5. return overall size of all bytes written.
     return blockOffsetSize + blockOffset;
 }
@@ -5,15 +5,27 @@
 #include "Block.h"
 
 
+// Bitmaps are written in the CRoaring frozen format so readers can use them directly from the file buffer without
+// deserializing them.
 class RoaringBitMapBlockWriter : public BlockWriter<roaring::Roaring *> {
 public:
-    explicit RoaringBitMapBlockWriter(uint64_t blockSize) : BlockWriter<roaring::Roaring *>(blockSize) {};
+    explicit RoaringBitMapBlockWriter(uint64_t blockSize) : BlockWriter<roaring::Roaring *>(blockSize,
+                                                                                            FROZEN_BITMAP_ALIGNMENT) {};
 
     void writeValue(FileWriteBuffer &f, roaring::Roaring *value) override {
-        f.write([&](char *data) { value->write(data, false); }, value->getSizeInBytes(false));
+        f.write([&](char *data) { value->writeFrozen(data); }, value->getFrozenSizeInBytes());
+    };
+
+    void writeValueAt(FileWriteBuffer &f, uint64_t offset, roaring::Roaring *value) override {
+        f.writeAt(offset, [&](char *data) { value->writeFrozen(data); }, value->getFrozenSizeInBytes());
     };
 };
 
+class QueryExecutor;
+
+// Default bytes of blocks serialized concurrently at a time by a parallel writeToFile.
+const uint64_t PARALLEL_WRITE_BATCH_SIZE = 1 << 26;
+
 
 class RoaringBitmapColumnWriter {
 public:
@@ -21,10 +33,13 @@ public:
 
     void addBitmap(roaring::Roaring *bitmap);
 
-    uint64_t writeToFile(FileWriteBuffer &f);
+    // With an executor the blocks are laid out in order and then serialized concurrently into their reserved space,
+    // batchSize bytes of blocks at a time, a batch holds at least one block. The bytes written are the same either way.
+    uint64_t writeToFile(FileWriteBuffer &f, QueryExecutor *executor = nullptr,
+                         uint64_t batchSize = PARALLEL_WRITE_BATCH_SIZE);
 
 private:
-    RoaringBitMapBlockWriter blockSize;
+    uint64_t blockSize;
     RoaringBitMapBlockWriter currentWriteBlock;
     std::vector<RoaringBitMapBlockWriter> blocks;
 };
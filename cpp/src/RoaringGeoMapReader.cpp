@@ -1,23 +1,55 @@
 #include "RoaringGeoMapReader.h"
 #include "CellIdColumnReader.h"
 #include "s2/s2latlng.h"
+#include "s2/s2cell.h"
+#include "s2/s1chord_angle.h"
 #include <s2/s2region_coverer.h>
+#include <s2/s2cap.h>
+#include <algorithm>
+#include <optional>
 
 const int MIN_LEVEL = 3;
+const int NEAREST_DISTANCE_COVER_CELLS = 64;
+// Blocks of a parallel query are split into a few partitions per thread, so threads finishing cheap partitions early
+// pick up more work.
+const size_t PARTITIONS_PER_THREAD = 4;
 
-RoaringGeoMapReader::RoaringGeoMapReader(const std::string &filePath) {
-    // Create a read buffer from the file path using FileReadBuffer
-    f = std::make_unique<FileReadBuffer>(filePath);
+namespace {
+    // Sorts ranges and merges the overlapping ones in place.
+    void sortAndMergeRanges(std::vector<std::pair<uint64_t, uint64_t>> &ranges) {
+        std::sort(ranges.begin(), ranges.end());
+        size_t merged = 0;
+        for (const auto &range: ranges) {
+            if (merged > 0 && range.first <= ranges[merged - 1].second)
+                ranges[merged - 1].second = std::max(ranges[merged - 1].second, range.second);
+            else
+                ranges[merged++] = range;
+        }
+        ranges.resize(merged);
+    }
+}
+
+RoaringGeoMapReader::RoaringGeoMapReader(const std::string &filePath, FileReadBuffer::Mode mode) :
+        RoaringGeoMapReader(filePath, RoaringGeoMapReaderOptions{.bufferMode = mode}) {}
+
+RoaringGeoMapReader::RoaringGeoMapReader(const std::string &filePath, const RoaringGeoMapReaderOptions &options) {
+    // Create a read buffer from the file path using FileReadBuffer, when memory mapped only the header and the pages
+    // touched below are read on open.
+    f = std::make_unique<FileReadBuffer>(filePath, options.bufferMode);
     // Initialize other members or perform additional setup as needed
     header = Header::readFromFile(*f);
 
     auto coverBitmapPos = header.getCellIdFilterOffset();
-    cellFilter = CellFilter::deserialize(*f, coverBitmapPos.first, coverBitmapPos.second);
+    // The cell filter is probed by every query.
+    f->advise(coverBitmapPos.first, coverBitmapPos.second, FileReadBuffer::Advice::WillNeed);
+    cellFilter = CellFilter::deserialize(*f, coverBitmapPos.first, coverBitmapPos.second, header.getCellFilterType());
 
-    //roaring::Roaring64Map::frozenView(f->view(coverBitmapPos.first, coverBitmapPos.second));
-//
-//    auto containsBitmapPos = header.getContainsBitmapOffset();
-//    containsBitmap = roaring::Roaring64Map::frozenView(f->view(containsBitmapPos.first, containsBitmapPos.second));
+
+    auto [cellLevelBitmapsOffset, cellLevelBitmapsSize] = header.getCellLevelBitmapsPos();
+    if (cellLevelBitmapsSize > 0) {
+        f->advise(cellLevelBitmapsOffset, cellLevelBitmapsSize, FileReadBuffer::Advice::WillNeed);
+        cellLevelBitmaps.emplace(*f, cellLevelBitmapsOffset, cellLevelBitmapsSize);
+    }
 
     auto [keyColumnOffset, keyColumnSize] = header.getKeyIndexPos();
     keyColumn = std::make_unique<ByteColumnReader>(*f, keyColumnOffset, keyColumnSize, header.getKeyIndexEntries(),
@@ -25,116 +57,483 @@ RoaringGeoMapReader::RoaringGeoMapReader(const std::string &filePath) {
 
     auto [cellColumnOffset, cellColumnSize] = header.getCellIndexPos();
     cellIdColumn = std::make_unique<CellIdColumnReader>(*f, cellColumnOffset, cellColumnSize,
-                                                        header.getCellIndexEntries(), header.getBlockSize());
+                                                        header.getCellIndexEntries(), header.getBlockSize(),
+                                                        header.getBlockIndexLayout());
 
     auto [bitmapColumnOffset, bitmapColumnSize] = header.getBitmapPos();
     bitmapColumn = std::make_unique<RoaringBitmapColumnReader>(*f, bitmapColumnOffset, bitmapColumnSize,
                                                                header.getCellIndexEntries(), header.getBlockSize());
 
+    blockCache = std::make_unique<BlockCache>(options.blockCacheBytes);
+    executor = options.executor;
+    parallelBlockThreshold = options.parallelBlockThreshold;
+    queryStrategy = options.queryStrategy;
+    if (cellLevelBitmaps) {
+        std::array<uint64_t, CELL_LEVELS> cellsPerLevel{};
+        for (int level = 0; level < CELL_LEVELS; ++level)
+            cellsPerLevel[level] = cellLevelBitmaps->cellCount(level);
+        planner = QueryPlanner(header.getCellIndexEntries(), header.getBlockSize(), header.getCellFilterType(),
+                               cellsPerLevel);
+    }
 }
 
 RoaringGeoMapReader::~RoaringGeoMapReader() = default;
 
 
-std::vector<std::vector<char>> RoaringGeoMapReader::Contains(const S2CellUnion &queryRegionNormalized) {
+QueryResults RoaringGeoMapReader::Contains(const S2CellUnion &queryRegionNormalized, QueryStats *stats) const {
+    QueryContext context;
+    Contains(queryRegionNormalized, context, stats);
+    return std::move(context.queryResults);
+}
 
-    // 1. Denormalize the cell id to the same levels that we stored the cells at.
-    auto queryRegion = std::vector<S2CellId>();
-    queryRegionNormalized.Denormalize(MIN_LEVEL, header.getLevelIndexBucketRange(), &queryRegion);
+const QueryResults &RoaringGeoMapReader::Contains(const S2CellUnion &queryRegionNormalized, QueryContext &context,
+                                                  QueryStats *stats) const {
+    context.clear();
+    context.startStages(stats != nullptr);
+    containedCells(queryRegionNormalized, context, nullptr);
+    queryKeyIds(context);
+    readKeys(context.keyIds, context.queryResults, &context.stats);
+    context.endStage(context.stats.keyFetchNanos);
+    if (stats != nullptr)
+        *stats = context.stats;
+    return context.queryResults;
+}
 
-    // Find the ranges of cellIds for each cell in the query region.
-    std::set<std::pair<uint64_t, uint64_t>> cellRanges;
-    for (auto cellId: queryRegion) {
-        auto min = cellId.range_min().id();
-        auto max = cellId.range_max().id();
-        auto result = (cellFilter.containsRange(min, max));
-        if (std::get<2>(result))
-            cellRanges.insert({std::get<0>(result), std::get<1>(result)});
-        // Insert the range of CellIds that contains the child cells of each cell in the query region.
+uint64_t RoaringGeoMapReader::ContainsCount(const S2CellUnion &queryRegionNormalized) const {
+    QueryContext context;
+    containedCells(queryRegionNormalized, context, nullptr);
+    queryKeyIds(context);
+    return context.keyIds.cardinality();
+}
+
+roaring::Roaring RoaringGeoMapReader::ContainsKeyIds(const S2CellUnion &queryRegionNormalized) const {
+    QueryContext context;
+    containedCells(queryRegionNormalized, context, nullptr);
+    queryKeyIds(context);
+    return std::move(context.keyIds);
+}
+
+QueryCursor RoaringGeoMapReader::ContainsCursor(const S2CellUnion &queryRegionNormalized, uint64_t offset,
+                                                uint64_t limit) const {
+    return {*keyColumn, header.getBlockSize(), ContainsKeyIds(queryRegionNormalized), offset, limit};
+}
+
+std::vector<QueryResults> RoaringGeoMapReader::ContainsBatch(std::span<const S2CellUnion> queries) const {
+    // 1. Filter probes are shared by the batch, cells and ancestors common to several queries are probed once.
+    FilterProbes probes;
+    std::vector<QueryContext> contexts(queries.size());
+    for (uint32_t query = 0; query < queries.size(); ++query)
+        containedCells(queries[query], contexts[query], &probes);
+
+    // 2. Read each block once for the whole batch, keys are views of the key column so each query reads its own.
+    queryKeyIdsBatch(contexts);
+    std::vector<QueryResults> results(queries.size());
+    for (size_t query = 0; query < queries.size(); ++query)
+        readKeys(contexts[query].keyIds, results[query]);
+    return results;
+}
+
+void RoaringGeoMapReader::queryKeyIdsBatch(std::span<QueryContext> contexts) const {
+    // 1. Plan the blocks of each context, then order every context's block probes by block so each block is read once
+    // for the whole batch.
+    struct BlockProbe {
+        uint32_t blockId;
+        uint32_t context;
+        uint32_t plan;
+    };
+    std::vector<BlockProbe> blockProbes;
+    for (uint32_t i = 0; i < contexts.size(); ++i) {
+        planBlocks(contexts[i]);
+        for (uint32_t plan = 0; plan < contexts[i].blockPlan.size(); ++plan)
+            blockProbes.push_back({contexts[i].blockPlan[plan].blockId, i, plan});
+    }
+    std::stable_sort(blockProbes.begin(), blockProbes.end(), [](const BlockProbe &a, const BlockProbe &b) {
+        return a.blockId < b.blockId;
+    });
+
+    // 2. Read each block once and collect the bitmaps found for each context.
+    for (size_t i = 0; i < blockProbes.size();) {
+        auto blockId = blockProbes[i].blockId;
+        auto cellIdBlock = cellIdColumn->ReadBlock(blockId);
+        auto keyIdBlock = readBitmapBlock(blockId);
+        for (; i < blockProbes.size() && blockProbes[i].blockId == blockId; ++i) {
+            auto &context = contexts[blockProbes[i].context];
+            context.bitmapBlocks.emplace_back(keyIdBlock);
+            queryBlockValues(cellIdBlock, *keyIdBlock, context.blockPlan[blockProbes[i].plan], context);
+        }
     }
 
-    // FInd the ancestor cells of each cell in the query region.
-    std::set < uint64_t > cellAncestors;
+    // 3. Union the key ids of each context.
+    for (auto &context: contexts)
+        context.keyIds = roaring::Roaring::fastunion(context.bitmaps.size(), context.bitmaps.data());
+}
+
+void RoaringGeoMapReader::containedCells(const S2CellUnion &queryRegionNormalized, QueryContext &context,
+                                         FilterProbes *probes) const {
+    // 1. Denormalize the cell id to the same levels that we stored the cells at.
+    auto &queryRegion = context.queryCells;
+    queryRegionNormalized.Denormalize(MIN_LEVEL, header.getLevelIndexBucketRange(), &queryRegion);
+    context.stats.queryCells = queryRegion.size();
+    context.endStage(context.stats.denormalizeNanos);
+
+    // 2. Collect the child range of each query cell and its ancestors at the levels of the index. Neighbouring query
+    // cells share most of their ancestors, each distinct ancestor is probed once.
+    auto &rangeProbes = context.rangeProbes;
+    for (auto cellId: queryRegion)
+        rangeProbes.emplace_back(cellId.range_min().id(), cellId.range_max().id());
+    auto &ancestorProbes = context.ancestorProbes;
     for (auto cellId: queryRegion) {
         for (int i = cellId.level() - header.getLevelIndexBucketRange();
              i >= MIN_LEVEL; i -= header.getLevelIndexBucketRange()) {
-            if (cellFilter.contains(cellId.parent(i).id()))
-                cellAncestors.insert(cellId.parent(i).id());
+            ancestorProbes.emplace_back(cellId.parent(i).id());
         }
     }
+    std::sort(ancestorProbes.begin(), ancestorProbes.end());
+    ancestorProbes.erase(std::unique(ancestorProbes.begin(), ancestorProbes.end()), ancestorProbes.end());
 
-    auto cellIdBlockIndex = cellIdColumn->BlockIndex();
-    auto blocksValues = cellIdBlockIndex.QueryValuesBlocks(cellRanges, cellAncestors);
-
-    // Needed to take ownership of the unique ptr returns by QueryValuesBlocks.
-    std::vector<std::unique_ptr<roaring::Roaring>> keyIds;
-    keyIds.reserve(blocksValues.size());
-    for (auto blockValue: blocksValues) {
-        keyIds.emplace_back(queryBlockValues(blockValue.blockId, blockValue.ranges, blockValue.values));
+    // 3. Probe the cell level bitmaps, when present, for the ancestors. The child ranges are probed in the cell filter
+    // unless the planner expects the query to read most of the blocks the ranges span anyway, then the ranges are
+    // planned as they are.
+    auto &stats = context.stats;
+    if (probes == nullptr) {
+        containsCells(ancestorProbes, context.cellAncestors);
+        stats.filterProbes += ancestorProbes.size();
+        context.endStage(stats.filterNanos);
+        planStrategy(context);
+        context.endStage(stats.planNanos);
+        if (context.queryPlan.strategy == QueryStrategy::FilterProbe) {
+            cellFilter.containsRangeMany(rangeProbes, context.cellRanges);
+            stats.filterProbes += rangeProbes.size();
+        } else {
+            context.cellRanges.assign(rangeProbes.begin(), rangeProbes.end());
+        }
+    } else {
+        for (size_t i = 0; i < queryRegion.size(); ++i) {
+            auto [it, inserted] = probes->ranges.try_emplace(queryRegion[i].id());
+            if (inserted) {
+                it->second = cellFilter.containsRange(rangeProbes[i].first, rangeProbes[i].second);
+                stats.filterProbes++;
+            }
+            auto [min, max, found] = it->second;
+            if (found)
+                context.cellRanges.emplace_back(min, max);
+        }
+        for (auto ancestor: ancestorProbes) {
+            auto [it, inserted] = probes->ancestors.try_emplace(ancestor);
+            if (inserted) {
+                it->second = containsCell(ancestor);
+                stats.filterProbes++;
+            }
+            if (it->second)
+                context.cellAncestors.emplace_back(ancestor);
+        }
     }
-    std::vector<const roaring::Roaring *> keyIdsPtrs;
-    keyIdsPtrs.reserve(keyIds.size());
-    for (const auto &keyId: keyIds) {
-        keyIdsPtrs.emplace_back(keyId.get());
+    stats.rangesFound = context.cellRanges.size();
+    stats.ancestorsFound = context.cellAncestors.size();
+    context.endStage(stats.filterNanos);
+}
+
+QueryResults RoaringGeoMapReader::Intersects(const S2CellUnion &queryRegion) const {
+    QueryContext context;
+    std::set<uint64_t> probedAncestors;
+    intersectingCells(queryRegion.cell_ids(), probedAncestors, context);
+
+    queryKeyIds(context);
+    readKeys(context.keyIds, context.queryResults);
+    return std::move(context.queryResults);
+}
+
+QueryResults RoaringGeoMapReader::Nearest(const S2Point &point, uint32_t k, S1Angle maxDistance) const {
+    if (k == 0)
+        return {};
+
+    S2CellId leaf(point);
+    // Rings are clipped to a covering of the max distance cap, so cells are only searched where they are within (about
+    // one covering cell of) maxDistance.
+    bool bounded = maxDistance < S1Angle::Infinity();
+    S2CellUnion distanceCover;
+    if (bounded) {
+        S2RegionCoverer::Options options;
+        options.set_max_cells(NEAREST_DISTANCE_COVER_CELLS);
+        S2RegionCoverer coverer(options);
+        distanceCover = coverer.GetCovering(S2Cap(point, maxDistance));
     }
 
-    auto resultKeyIds = roaring::Roaring::fastunion(keyIdsPtrs.size(), keyIdsPtrs.data());
-    auto keyBlockValues = queryBlocksByIndexes(resultKeyIds);
-    std::vector<std::vector<char>> results;
-    for (const auto &blockValue: keyBlockValues) {
-        auto block = keyColumn->ReadBlock(blockValue.blockId);
-        auto keyValues = block.readIndexes(blockValue.values);
-        results.insert(results.end(), keyValues.begin(), keyValues.end());
+    // Key ids in the order they were found and the set of them, the order is by the distance of the cell they were
+    // found in.
+    std::vector<uint32_t> orderedKeyIds;
+    roaring::Roaring foundKeyIds;
+
+    // Ancestors are shared by the cells of every ring, they are probed and read at most once over the whole search.
+    std::set<uint64_t> probedAncestors;
+    std::vector<QueryContext> contexts;
+    S2CellUnion searched;
+    for (int level = S2CellId::kMaxLevel; level >= 0 && orderedKeyIds.size() < k; --level) {
+        // Each ring is the cell containing the point and its neighbours at the level. A ring contains the previous
+        // (finer) ring, only the cells which were not already searched are queried. The neighbours of a face miss the
+        // opposite face, the last ring is every face.
+        std::vector<S2CellId> ringCells;
+        if (level == 0) {
+            for (int face = 0; face < S2CellId::kNumFaces; ++face)
+                ringCells.push_back(S2CellId::FromFace(face));
+        } else {
+            ringCells.push_back(leaf.parent(level));
+            leaf.parent(level).AppendAllNeighbors(level, &ringCells);
+        }
+        S2CellUnion ring(std::move(ringCells));
+        auto newCells = ring.Difference(searched);
+        if (bounded)
+            newCells = newCells.Intersection(distanceCover);
+        // The new cells surround the searched area, if none of them are within the max distance neither is anything
+        // outside of them.
+        if (newCells.empty())
+            break;
+
+        std::vector<std::pair<S1ChordAngle, S2CellId>> cellsByDistance;
+        for (auto cellId: newCells)
+            cellsByDistance.emplace_back(S2Cell(cellId).GetDistance(point), cellId);
+        std::sort(cellsByDistance.begin(), cellsByDistance.end(), [](const auto &a, const auto &b) {
+            return a.first < b.first;
+        });
+
+        // The cells of the ring are read as a batch, each block once, then their keys are taken nearest cell first.
+        if (contexts.size() < cellsByDistance.size())
+            contexts.resize(cellsByDistance.size());
+        std::span<QueryContext> ringContexts(contexts.data(), cellsByDistance.size());
+        for (size_t i = 0; i < cellsByDistance.size(); ++i) {
+            ringContexts[i].clear();
+            intersectingCells({cellsByDistance[i].second}, probedAncestors, ringContexts[i]);
+        }
+        queryKeyIdsBatch(ringContexts);
+        for (const auto &context: ringContexts) {
+            auto keyIds = context.keyIds - foundKeyIds;
+            for (auto keyId: keyIds)
+                orderedKeyIds.emplace_back(keyId);
+            foundKeyIds |= keyIds;
+            if (orderedKeyIds.size() >= k)
+                break;
+        }
+        searched = std::move(ring);
     }
+    if (orderedKeyIds.size() > k)
+        orderedKeyIds.resize(k);
 
+    // Keys are returned in the order they were found, by distance.
+    QueryResults results;
+    for (auto keyId: orderedKeyIds)
+        results.append(keyId, readKey(keyId));
     return results;
 }
 
-std::vector<std::vector<char>> RoaringGeoMapReader::Intersects(const S2CellUnion &cellIds) {
-    return {};
+void RoaringGeoMapReader::intersectingCells(const std::vector<S2CellId> &queryCells, std::set<uint64_t> &probedAncestors,
+                                            QueryContext &context) const {
+    // Unlike Contains the query cells are not denormalized to the levels of the index. The child range of each query
+    // cell is probed as is and ancestors are probed at every level, so cells indexed at any level are found.
+    for (auto cellId: queryCells) {
+        auto [min, max, found] = cellFilter.containsRange(cellId.range_min().id(), cellId.range_max().id());
+        if (found)
+            context.cellRanges.emplace_back(min, max);
+
+        // Cells of a region cover share most of their ancestors, each distinct ancestor is probed once. Once an
+        // ancestor has been probed so has the rest of its chain.
+        for (int level = cellId.level() - 1; level >= 0; --level) {
+            auto ancestor = cellId.parent(level).id();
+            if (!probedAncestors.insert(ancestor).second)
+                break;
+            if (containsCell(ancestor))
+                context.cellAncestors.emplace_back(ancestor);
+        }
+    }
+}
+
+bool RoaringGeoMapReader::containsCell(uint64_t cellId) const {
+    return cellLevelBitmaps ? cellLevelBitmaps->contains(cellId) : cellFilter.contains(cellId);
+}
+
+void RoaringGeoMapReader::containsCells(std::span<const uint64_t> cellIds, std::vector<uint64_t> &found) const {
+    if (cellLevelBitmaps)
+        cellLevelBitmaps->containsMany(cellIds, found);
+    else
+        cellFilter.containsMany(cellIds, found);
+}
+
+void RoaringGeoMapReader::planStrategy(QueryContext &context) const {
+    auto &plan = context.queryPlan;
+    plan.queryCells = context.queryCells.size();
+    plan.ancestorProbes = context.ancestorProbes.size();
+    plan.ancestorsFound = context.cellAncestors.size();
+    if (queryStrategy != QueryStrategy::Auto) {
+        plan.strategy = queryStrategy;
+        return;
+    }
+    if (!cellLevelBitmaps || context.rangeProbes.empty())
+        return;
+
+    // The query runs from its first to its last cell id, query cells are sorted so their ranges are too.
+    uint64_t spanStart = context.rangeProbes.front().first;
+    uint64_t spanEnd = context.rangeProbes.back().second;
+    if (!context.cellAncestors.empty()) {
+        // Ancestors are not sorted until the blocks are planned.
+        auto [minAncestor, maxAncestor] = std::minmax_element(context.cellAncestors.begin(),
+                                                              context.cellAncestors.end());
+        spanStart = std::min(spanStart, *minAncestor);
+        spanEnd = std::max(spanEnd, *maxAncestor);
+    }
+    const auto &blockIndex = cellIdColumn->BlockIndex();
+    uint32_t firstBlock = blockIndex.FindBlock(spanStart);
+    if (firstBlock == blockIndex.BlockCount()) {
+        // The query starts after the last block, there is nothing to read whichever strategy runs.
+        planner.choose(context.queryCells, spanStart, spanEnd, 0, plan);
+        return;
+    }
+    uint32_t lastBlock = std::min(blockIndex.FindBlock(spanEnd), blockIndex.BlockCount() - 1);
+    // Block i holds the cell ids after the max of block i - 1 up to its own max.
+    uint64_t blocksStart = firstBlock == 0 ? 0 : blockIndex.BlockMax(firstBlock - 1) + 1;
+    planner.choose(context.queryCells, blocksStart, blockIndex.BlockMax(lastBlock), lastBlock - firstBlock + 1, plan);
+}
+
+void RoaringGeoMapReader::planBlocks(QueryContext &context) const {
+    // Ranges and ancestors are planned together, a block holding both child and ancestor cells is read once.
+    sortAndMergeRanges(context.cellRanges);
+    std::sort(context.cellAncestors.begin(), context.cellAncestors.end());
+    context.cellAncestors.erase(std::unique(context.cellAncestors.begin(), context.cellAncestors.end()),
+                                context.cellAncestors.end());
+    if (context.queryPlan.strategy == QueryStrategy::Scan)
+        cellIdColumn->BlockIndex().ScanValuesBlocks(context.cellRanges, context.cellAncestors, context.blockPlan);
+    else
+        cellIdColumn->BlockIndex().QueryValuesBlocks(context.cellRanges, context.cellAncestors, context.blockPlan);
+    context.queryPlan.blocksPlanned = context.blockPlan.size();
+    context.stats.blocksPlanned = context.blockPlan.size();
+    context.endStage(context.stats.planNanos);
+}
+
+void RoaringGeoMapReader::queryKeyIds(QueryContext &context) const {
+    planBlocks(context);
+    if (executor && context.blockPlan.size() >= parallelBlockThreshold) {
+        queryKeyIdsParallel(context);
+        return;
+    }
+    readBlocks(context.blockPlan, context);
+}
+
+void RoaringGeoMapReader::readBlocks(std::span<const S2BlockValues<uint64_t>> blocks, QueryContext &scratch) const {
+    for (const auto &blockValues: blocks) {
+        // CellId blocks are views over the read buffer and are cheap to open, only the decoded bitmap block is cached.
+        auto cellIdBlock = cellIdColumn->ReadBlock(blockValues.blockId);
+        scratch.bitmapBlocks.emplace_back(readBitmapBlock(blockValues.blockId));
+        queryBlockValues(cellIdBlock, *scratch.bitmapBlocks.back(), blockValues, scratch);
+    }
+    scratch.endStage(scratch.stats.blockProbeNanos);
+    // The bitmaps of every block are unioned at once rather than per block.
+    scratch.keyIds = roaring::Roaring::fastunion(scratch.bitmaps.size(), scratch.bitmaps.data());
+    scratch.stats.unionCardinality = scratch.keyIds.cardinality();
+    scratch.endStage(scratch.stats.unionNanos);
+}
+
+void RoaringGeoMapReader::queryKeyIdsParallel(QueryContext &context) const {
+    std::span<const S2BlockValues<uint64_t>> blocks = context.blockPlan;
+    size_t partitionCount = std::min<size_t>(blocks.size(), executor->concurrency() * PARTITIONS_PER_THREAD);
+    if (context.partitions.size() < partitionCount)
+        context.partitions.resize(partitionCount);
+
+    // 1. Each partition reads a contiguous run of blocks and unions the bitmaps found in it.
+    executor->parallelFor(partitionCount, [&](size_t partition) {
+        auto &scratch = context.partitions[partition];
+        scratch.clear();
+        size_t begin = blocks.size() * partition / partitionCount;
+        size_t end = blocks.size() * (partition + 1) / partitionCount;
+        readBlocks(blocks.subspan(begin, end - begin), scratch);
+    });
+    for (size_t partition = 0; partition < partitionCount; ++partition) {
+        const auto &partitionStats = context.partitions[partition].stats;
+        context.stats.cellIdEntriesScanned += partitionStats.cellIdEntriesScanned;
+        context.stats.bitmapsRead += partitionStats.bitmapsRead;
+        context.stats.bitmapsDecoded += partitionStats.bitmapsDecoded;
+        context.stats.bytesTouched += partitionStats.bytesTouched;
+    }
+    context.endStage(context.stats.blockProbeNanos);
+
+    // 2. Union the partitions pairwise, halving the number of partitions each round, so the union of large results is
+    // spread over the threads rather than done by one.
+    for (size_t stride = 1; stride < partitionCount; stride *= 2) {
+        size_t pairs = (partitionCount + (2 * stride) - 1) / (2 * stride);
+        executor->parallelFor(pairs, [&](size_t pair) {
+            size_t left = pair * 2 * stride;
+            size_t right = left + stride;
+            if (right < partitionCount)
+                context.partitions[left].keyIds |= context.partitions[right].keyIds;
+        });
+    }
+    context.keyIds = std::move(context.partitions[0].keyIds);
+    context.stats.unionCardinality = context.keyIds.cardinality();
+    context.endStage(context.stats.unionNanos);
+}
+
+void RoaringGeoMapReader::readKeys(const roaring::Roaring &keyIds, QueryResults &results, QueryStats *stats) const {
+    results.clear();
+    results.keyIds.reserve(keyIds.cardinality());
+    results.keys.reserve(keyIds.cardinality());
+    // Key ids are sorted, each key block is opened once for the run of key ids falling in it.
+    uint32_t blockSize = header.getBlockSize();
+    std::optional<BytesBlockReader> block;
+    uint32_t blockId = 0;
+    for (auto keyId: keyIds) {
+        uint32_t keyBlockId = keyId / blockSize;
+        if (!block || keyBlockId != blockId) {
+            block.emplace(keyColumn->ReadBlock(keyBlockId));
+            blockId = keyBlockId;
+            if (stats != nullptr) {
+                stats->keyBlocksRead++;
+                stats->bytesTouched += block->sizeOf();
+            }
+        }
+        // normalize keyId by it's block. I.e we ask for index 513 of the entire column, however within the block
+        // this is index 0;
+        results.append(keyId, block->readView(keyId - (keyBlockId * blockSize)));
+    }
 }
 
+std::string_view RoaringGeoMapReader::readKey(uint32_t keyId) const {
+    uint32_t blockSize = header.getBlockSize();
+    uint32_t keyBlockId = keyId / blockSize;
+    return keyColumn->ReadBlock(keyBlockId).readView(keyId - (keyBlockId * blockSize));
+}
 
-std::unique_ptr<roaring::Roaring>
-RoaringGeoMapReader::queryBlockValues(uint32_t &blockId, std::vector<std::pair<uint64_t, uint64_t>> &ranges,
-                                      std::vector<uint64_t> &values) {
+void RoaringGeoMapReader::queryBlockValues(Uint64BlockReader &cellIdBlock, const DecodedBitmapBlock &keyIdBlock,
+                                           const S2BlockValues<uint64_t> &blockValues, QueryContext &context) const {
     // CellId and KeyId (RoaringBitMap columns are aligned. Cell Ids found at index x in the cell block's correspond
     // to bitmaps of all keyIds present in the cell at the same index.
-    auto cellIdBlock = cellIdColumn->ReadBlock(blockId); // TODO should probably cache this
-    auto keyIdBlock = bitmapColumn->ReadBlock(blockId);
-
-    auto indexes = cellIdBlock.queryValueIndexes(values);
-    auto indexRanges = cellIdBlock.queryValueRangesIndexes(ranges);
-
-    std::vector<const roaring::Roaring *> keyIds;
-    auto rangeBitmaps = keyIdBlock.readIndexRanges(indexRanges);
-    auto indexBitmaps = keyIdBlock.readIndexes(indexes);
-    keyIds.reserve(rangeBitmaps.size() + indexBitmaps.size());
-    for (const auto &bitmap: rangeBitmaps)
-        keyIds.emplace_back(bitmap.get());
-    for (const auto &bitmap: indexBitmaps)
-        keyIds.emplace_back(bitmap.get());
-
-    return std::make_unique<roaring::Roaring>(std::move(roaring::Roaring::fastunion(keyIds.size(), keyIds.data())));
-}
-
-std::vector<BlockValues<uint32_t>> RoaringGeoMapReader::queryBlocksByIndexes(roaring::Roaring &queryValues) {
-    std::vector<BlockValues<uint32_t>> results;
-    for (const auto &query: queryValues) {
-        // Find the first index in `values` that is greater than or equal to `query`.
-        uint32_t blockIndex = query / header.getBlockSize();
-        uint32_t blockQueryIndex = query - (blockIndex * header.getBlockSize());
-        // Calculate the block index.
-        if (results.empty() || results.back().blockId != blockIndex) {
-            // normalize queryIndex by it's block. I.e we ask for index 513 of the entire column, however within the
-            // block this is index 0;
-            results.push_back({blockIndex, {blockQueryIndex}});
-        } else {
-            results.back().values.emplace_back(blockQueryIndex);
-        }
+    cellIdBlock.queryValueIndexes(blockValues.values, context.indexes);
+    cellIdBlock.queryValueRangesIndexes(blockValues.ranges, context.indexRanges);
+
+    auto &stats = context.stats;
+    size_t bitmapsBefore = context.bitmaps.size();
+    for (const auto &[start, end]: context.indexRanges) {
+        for (uint32_t index = start; index <= end; ++index)
+            context.bitmaps.emplace_back(&keyIdBlock.bitmap(index, stats.bitmapsDecoded));
     }
-    return results;
+    for (auto index: context.indexes)
+        context.bitmaps.emplace_back(&keyIdBlock.bitmap(index, stats.bitmapsDecoded));
+    stats.cellIdEntriesScanned += cellIdBlock.entryCount();
+    stats.bitmapsRead += context.bitmaps.size() - bitmapsBefore;
+    stats.bytesTouched += cellIdBlock.sizeOf() + keyIdBlock.sizeOf();
 }
 
+std::shared_ptr<const DecodedBitmapBlock> RoaringGeoMapReader::readBitmapBlock(uint32_t blockId) const {
+    return blockCache->getOrLoad<DecodedBitmapBlock>(BlockColumn::Bitmap, blockId, [&] {
+        auto block = std::make_shared<DecodedBitmapBlock>(bitmapColumn->ReadBlock(blockId));
+        auto cost = block->sizeInBytes();
+        return std::make_pair(std::move(block), cost);
+    });
+}
 
+QueryPlan RoaringGeoMapReader::ExplainContains(const S2CellUnion &queryRegionNormalized) const {
+    QueryContext context;
+    containedCells(queryRegionNormalized, context, nullptr);
+    planBlocks(context);
+    return context.queryPlan;
+}
 
+BlockCacheStats RoaringGeoMapReader::BlockCacheStatistics() const {
+    return blockCache->stats();
+}
@@ -4,41 +4,172 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <span>
+#include <map>
+#include <set>
 #include "roaring/roaring.h" // Include the Roaring Bitmap library
 #include "s2/s2cell_id.h"     // Include the S2 library
 #include "Header.h"
 #include "roaring64map.hh"
 #include "CellIdColumnReader.h"
 #include "s2/s2cell_union.h"
+#include "s2/s1angle.h"
+#include "s2/s2point.h"
 #include "ByteColumnReader.h"
 #include "RoaringBitmapColumnReader.h"
 #include "CellFilter.h"
+#include "CellLevelBitmaps.h"
+#include "BlockCache.h"
+#include "QueryContext.h"
+#include "QueryStats.h"
+#include "QueryCursor.h"
+#include "QueryExecutor.h"
+#include <limits>
+#include <optional>
 
+// Default byte budget of the reader's decoded block cache.
+const uint64_t DEFAULT_BLOCK_CACHE_BYTES = 64 * 1024 * 1024;
+const uint32_t DEFAULT_PARALLEL_BLOCK_THRESHOLD = 64;
+
+struct RoaringGeoMapReaderOptions {
+    FileReadBuffer::Mode bufferMode = FileReadBuffer::Mode::Mmap;
+    // Byte budget of the decoded block cache shared by all queries of the reader, 0 disables the cache.
+    uint64_t blockCacheBytes = DEFAULT_BLOCK_CACHE_BYTES;
+    // When set, queries reading at least parallelBlockThreshold blocks read the blocks and union their bitmaps on the
+    // executor. Smaller queries run on the calling thread where the hand off would cost more than it saves.
+    std::shared_ptr<QueryExecutor> executor;
+    uint32_t parallelBlockThreshold = DEFAULT_PARALLEL_BLOCK_THRESHOLD;
+    // Strategy of Contains queries, Auto chooses one per query from the estimated cost of each. Without cell level
+    // bitmaps there are no statistics to estimate from and Auto always probes the cell filter.
+    QueryStrategy queryStrategy = QueryStrategy::Auto;
+};
+
+// RoaringGeoMapReader queries an index file. Queries are const and a single reader can be shared by any number of
+// threads: the read buffer, header, cell filter and column readers are immutable once the reader is constructed, the
+// block cache is internally synchronised and all per query state lives in the query or in its QueryContext. A
+// QueryContext or QueryCursor must only be used by one thread at a time.
 class RoaringGeoMapReader {
 
 public:
-    // Constructor that takes a file path and constructs a read buffer
-    explicit RoaringGeoMapReader(const std::string &filePath);
+    // Constructor that takes a file path and constructs a read buffer, by default the file is memory mapped.
+    explicit RoaringGeoMapReader(const std::string &filePath, FileReadBuffer::Mode mode = FileReadBuffer::Mode::Mmap);
+
+    RoaringGeoMapReader(const std::string &filePath, const RoaringGeoMapReaderOptions &options);
 
     ~RoaringGeoMapReader();
 
-    std::vector<std::vector<char>> Contains(const S2CellUnion &cellIds);
+    // Returns the keys of all cells in the index that are children or ancestors of the query region once it is
+    // denormalized to the levels of the index. Results of every query are views into the index and must not outlive
+    // the reader.
+    // When stats is not null it is filled with the work done by the query and the time spent in each stage.
+    QueryResults Contains(const S2CellUnion &cellIds, QueryStats *stats = nullptr) const;
+
+    // Contains using the scratch space of context, the returned results belong to the context and are valid until it
+    // runs another query. Reusing a context avoids the allocations of building each query's plan and results.
+    const QueryResults &Contains(const S2CellUnion &cellIds, QueryContext &context, QueryStats *stats = nullptr) const;
+
+    // Returns the number of keys Contains would return. Only the key id bitmaps are read, the key column is not.
+    uint64_t ContainsCount(const S2CellUnion &cellIds) const;
+
+    // Returns the ids of the keys Contains would return, e.g. to intersect with other filters. Only the key id bitmaps
+    // are read, the key column is not.
+    roaring::Roaring ContainsKeyIds(const S2CellUnion &cellIds) const;
 
-    std::vector<std::vector<char>> Intersects(const S2CellUnion &cellIds);
+    // Returns a cursor over the keys Contains would return, in key id order, skipping the first offset keys and
+    // stopping after limit keys. Key blocks are read as the cursor advances.
+    QueryCursor ContainsCursor(const S2CellUnion &cellIds, uint64_t offset = 0,
+                               uint64_t limit = std::numeric_limits<uint64_t>::max()) const;
+
+    // Runs Contains for each query region and returns the results in the same order. Filter probes and CellId and
+    // bitmap block reads are shared by the batch, so each block is read at most once however many queries hit it.
+    std::vector<QueryResults> ContainsBatch(std::span<const S2CellUnion> queries) const;
+
+    // Returns the keys whose region cover intersects the query region: any indexed cell within a query cell or any
+    // indexed ancestor of a query cell at any level. The query is not denormalized, so covers written at levels outside
+    // of the index's level bucket range are matched as well.
+    QueryResults Intersects(const S2CellUnion &cellIds) const;
+
+    // Returns up to k keys nearest to point, ordered by the distance from point to the indexed cell they were found in.
+    // Rings of the cell containing point and its neighbours are searched level by level from the leaf level outwards,
+    // up to every face cell, and the cells of a ring are read as a batch. The search stops once k keys are found or the
+    // remaining cells are further than maxDistance. maxDistance is applied at the granularity of a cell covering of the
+    // max distance cap.
+    QueryResults Nearest(const S2Point &point, uint32_t k, S1Angle maxDistance = S1Angle::Infinity()) const;
+
+    // Returns the plan Contains would run for the query region, including the number of blocks it would read, without
+    // reading any block.
+    QueryPlan ExplainContains(const S2CellUnion &cellIds) const;
+
+    // Hit and miss counters and the current size of the decoded block cache.
+    BlockCacheStats BlockCacheStatistics() const;
 
 private:
+    // Memoized cell filter probes, keyed by the query cell (for ranges) and the ancestor cell id.
+    struct FilterProbes {
+        std::map<uint64_t, std::tuple<uint64_t, uint64_t, bool>> ranges;
+        std::map<uint64_t, bool> ancestors;
+    };
+
     std::unique_ptr<FileReadBuffer> f;
     Header header;
     CellFilter cellFilter;
+    std::optional<CellLevelBitmapsReader> cellLevelBitmaps;
     std::unique_ptr<ByteColumnReader> keyColumn;
     std::unique_ptr<CellIdColumnReader> cellIdColumn;
     std::unique_ptr<RoaringBitmapColumnReader> bitmapColumn;
+    std::unique_ptr<BlockCache> blockCache;
+    std::shared_ptr<QueryExecutor> executor;
+    uint32_t parallelBlockThreshold;
+    QueryStrategy queryStrategy;
+    QueryPlanner planner;
+
+    // Whether cellId was written to the index, from the cell level bitmaps when the file has them and otherwise from the
+    // cell filter, which may report false positives.
+    bool containsCell(uint64_t cellId) const;
+
+    // Appends each of cellIds written to the index to found, cellIds are sorted and unique.
+    void containsCells(std::span<const uint64_t> cellIds, std::vector<uint64_t> &found) const;
+
+    // Returns the bitmap block from the block cache, reading it on a miss.
+    std::shared_ptr<const DecodedBitmapBlock> readBitmapBlock(uint32_t blockId) const;
+
+    // Appends the bitmaps of the block's cells matching blockValues to the context's bitmaps.
+    void queryBlockValues(Uint64BlockReader &cellIdBlock, const DecodedBitmapBlock &keyIdBlock,
+                          const S2BlockValues<uint64_t> &blockValues, QueryContext &context) const;
+
+    // Collects the child ranges and ancestors of the query region, denormalized to the levels of the index, present in
+    // the cell filter. When probes is not null filter probe results are memoized in it, otherwise the child ranges are
+    // collected according to the strategy planned for the query.
+    void containedCells(const S2CellUnion &queryRegion, QueryContext &context, FilterProbes *probes) const;
+
+    // Chooses the strategy of the query from the reader's options and the planner.
+    void planStrategy(QueryContext &context) const;
+
+    // Sorts the context's cell ranges and ancestors and plans the blocks to read for them.
+    void planBlocks(QueryContext &context) const;
+
+    // Plans and reads the blocks of the context's cells, leaving the key ids found in the context.
+    void queryKeyIds(QueryContext &context) const;
+
+    // Reads blocks and unions the bitmaps of their matching cells into scratch's key ids.
+    void readBlocks(std::span<const S2BlockValues<uint64_t>> blocks, QueryContext &scratch) const;
+
+    // Plans the blocks of each context and reads each block once for all of them, leaving each context's key ids.
+    void queryKeyIdsBatch(std::span<QueryContext> contexts) const;
+
+    // queryKeyIds for large plans, partitions of the blocks are read in parallel and their key ids are unioned in a
+    // tree reduction.
+    void queryKeyIdsParallel(QueryContext &context) const;
+
+    // Reads the keys of keyIds into results, counting the key blocks read in stats when it is not null.
+    void readKeys(const roaring::Roaring &keyIds, QueryResults &results, QueryStats *stats = nullptr) const;
 
-    std::unique_ptr<roaring::Roaring>
-    queryBlockValues(uint32_t &blockId, std::vector<std::pair<uint64_t, uint64_t>> &valueRanges,
-                     std::vector<uint64_t> &values);
+    std::string_view readKey(uint32_t keyId) const;
 
-    std::vector<BlockValues<uint32_t>> queryBlocksByIndexes(roaring::Roaring &queryValues);
+    // Collects the child ranges and ancestors of queryCells present in the cell filter. Ancestors already in
+    // probedAncestors are skipped and every ancestor probed is added to it.
+    void intersectingCells(const std::vector<S2CellId> &queryCells, std::set<uint64_t> &probedAncestors,
+                           QueryContext &context) const;
 };
 
 #endif // ROARING_GEO_MAP_READER_H
\ No newline at end of file
@@ -5,28 +5,169 @@
 #include "io/FileWriteBuffer.h"
 #include "RoaringBitmapColumnWriter.h"
 #include "Header.h"
+#include "RadixSort.h"
+#include "QueryExecutor.h"
+#include "ColumnStreamWriter.h"
 #include <algorithm>
+#include <filesystem>
+#include <limits>
 
-const int MIN_LEVEL = 3;
 const uint64_t BLOCK_SIZE = 1024;
+// A parallel build splits the keys and the cell id space into this many tasks per thread, so uneven tasks balance.
+const size_t BUILD_TASKS_PER_THREAD = 4;
+// Cells sampled per partition when choosing the cell ranges of a parallel build.
+const size_t SPLITTER_SAMPLES_PER_PARTITION = 64;
+
+namespace {
+    struct KeyOrder {
+        uint64_t minCell;
+        uint32_t writeIndex;
+    };
+
+    // A range of the cell id space, its (cellId, key_id) pairs and once built its unique cells and the bitmap of
+    // key_ids of each cell.
+    struct CellPartition {
+        std::vector<CellKey> cellKeys;
+        std::vector<uint64_t> cells;
+        std::vector<roaring::Roaring> keyIdBitmaps;
+    };
+
+    // Runs task(i) for every i in [0, n) on the executor, or on the calling thread without one.
+    void forEachTask(QueryExecutor *executor, size_t n, const std::function<void(size_t)> &task) {
+        if (executor != nullptr) {
+            executor->parallelFor(n, task);
+            return;
+        }
+        for (size_t i = 0; i < n; ++i)
+            task(i);
+    }
+
+    // Returns up to partitionCount - 1 cell ids splitting a sample of cells into ranges holding about as many cells,
+    // partitions stay balanced when the data covers a small part of a single face.
+    std::vector<uint64_t> cellRangeSplitters(const std::vector<uint64_t> &cells, size_t partitionCount) {
+        std::vector<uint64_t> splitters;
+        if (partitionCount <= 1 || cells.empty())
+            return splitters;
+        size_t sampleSize = std::min(cells.size(), partitionCount * SPLITTER_SAMPLES_PER_PARTITION);
+        std::vector<uint64_t> sample(sampleSize);
+        for (size_t i = 0; i < sampleSize; ++i)
+            sample[i] = cells[i * cells.size() / sampleSize];
+        std::sort(sample.begin(), sample.end());
+        for (size_t p = 1; p < partitionCount; ++p)
+            splitters.push_back(sample[p * sampleSize / partitionCount]);
+        splitters.erase(std::unique(splitters.begin(), splitters.end()), splitters.end());
+        return splitters;
+    }
+
+    // Sorts the partition's pairs by cellId and builds the bitmap of key_ids of each unique cell from its run of pairs.
+    // The sort is stable so the key_ids of a run come out sorted, ready to be bulk added to the bitmap.
+    void buildPartition(CellPartition &partition) {
+        std::vector<CellKey> scratch;
+        radixSort(partition.cellKeys, scratch, [](const CellKey &c) { return c.cellId; });
+        scratch = {};
+
+        const auto &cellKeys = partition.cellKeys;
+        std::vector<uint32_t> runKeyIds;
+        for (size_t runStart = 0, runEnd; runStart < cellKeys.size(); runStart = runEnd) {
+            runKeyIds.clear();
+            for (runEnd = runStart; runEnd < cellKeys.size() && cellKeys[runEnd].cellId == cellKeys[runStart].cellId; ++runEnd)
+                runKeyIds.push_back(cellKeys[runEnd].keyId);
+            partition.cells.push_back(cellKeys[runStart].cellId);
+            partition.keyIdBitmaps.emplace_back().addMany(runKeyIds.size(), runKeyIds.data());
+        }
+        partition.cellKeys = {};
+    }
+
+    // Splits the cell id space into ranges and scatters the (cellId, key_id) pairs of each chunk of keys into the range
+    // partitions, then builds the bitmaps of each partition. The pairs of a partition stay in key_id order as chunks
+    // are placed one after the other.
+    std::vector<CellPartition> buildPartitions(const std::vector<KeyOrder> &keyOrder, const std::vector<uint64_t> &cells,
+                                               const std::vector<uint64_t> &keyCellEnds, QueryExecutor *executor,
+                                               size_t taskCount) {
+        uint32_t keyCount = keyOrder.size();
+        auto splitters = cellRangeSplitters(cells, taskCount);
+        std::vector<CellPartition> partitions(splitters.size() + 1);
+        auto partitionOf = [&](uint64_t cellId) {
+            return std::upper_bound(splitters.begin(), splitters.end(), cellId) - splitters.begin();
+        };
+        auto forEachCell = [&](size_t chunk, const auto &func) {
+            uint32_t chunkStart = uint64_t(keyCount) * chunk / taskCount;
+            uint32_t chunkEnd = uint64_t(keyCount) * (chunk + 1) / taskCount;
+            for (uint32_t keyId = chunkStart; keyId < chunkEnd; ++keyId) {
+                uint32_t writeIndex = keyOrder[keyId].writeIndex;
+                uint64_t coverStart = writeIndex == 0 ? 0 : keyCellEnds[writeIndex - 1];
+                for (uint64_t i = coverStart; i < keyCellEnds[writeIndex]; ++i)
+                    func(cells[i], keyId);
+            }
+        };
+
+        std::vector<std::vector<uint64_t>> chunkPositions(taskCount, std::vector<uint64_t>(partitions.size()));
+        forEachTask(executor, taskCount, [&](size_t chunk) {
+            forEachCell(chunk, [&](uint64_t cellId, uint32_t) { chunkPositions[chunk][partitionOf(cellId)]++; });
+        });
+        for (size_t p = 0; p < partitions.size(); ++p) {
+            uint64_t position = 0;
+            for (auto &positions: chunkPositions) {
+                uint64_t count = positions[p];
+                positions[p] = position;
+                position += count;
+            }
+            partitions[p].cellKeys.resize(position);
+        }
+        forEachTask(executor, taskCount, [&](size_t chunk) {
+            auto &positions = chunkPositions[chunk];
+            forEachCell(chunk, [&](uint64_t cellId, uint32_t keyId) {
+                auto p = partitionOf(cellId);
+                partitions[p].cellKeys[positions[p]++] = {cellId, keyId};
+            });
+        });
+
+        // Partitions cover ascending cell ranges so their cells follow each other.
+        forEachTask(executor, partitions.size(), [&](size_t p) { buildPartition(partitions[p]); });
+        return partitions;
+    }
+}
 
 RoaringGeoMapWriter::RoaringGeoMapWriter(int levelIndexBucketRange) : levelIndexBucketRange(levelIndexBucketRange) {}
 
-// Writes a new Key -> region cover pair to be indexed in the index. For now, we will assume the entire can be constructed
-// only in memory.
+RoaringGeoMapWriter::RoaringGeoMapWriter(int levelIndexBucketRange, const RoaringGeoMapWriterOptions &options) :
+        levelIndexBucketRange(levelIndexBucketRange), options(options) {
+    if (options.buildMemoryBudget > 0) {
+        std::string directory = options.buildTempDirectory.empty() ? std::filesystem::temp_directory_path().string()
+                                                                   : options.buildTempDirectory;
+        cellKeyRuns = std::make_unique<CellKeyRuns>(directory, options.buildMemoryBudget);
+        keySpill = std::make_unique<KeySpill>(directory, options.buildMemoryBudget);
+    }
+}
+
+// Writes a new Key -> region cover pair to be indexed in the index. Keys and covers are held in memory unless the options
+// set a memory budget, then they are spilled to temp files.
 bool RoaringGeoMapWriter::write(const S2CellUnion &region, const std::string &key) {
 
-    // 1. Get normalized region cover
-    auto normalizedRegion = std::make_unique<std::vector<S2CellId>>(); // May not need a unique pointer do to the lifetime
-    region.Denormalize(MIN_LEVEL, levelIndexBucketRange, normalizedRegion.get());
+    // 1. Append the key and its cover to the flat arrays, the cover is kept sorted and unique per key.
+    const auto *regionPtr = reinterpret_cast<const uint64_t *>(region.data());
+    auto coverStart = cells.size();
+    cells.insert(cells.end(), regionPtr, regionPtr + region.size());
+    auto cover = cells.begin() + coverStart;
+    if (!std::is_sorted(cover, cells.end()))
+        std::sort(cover, cells.end());
+    cells.erase(std::unique(cover, cells.end()), cells.end());
 
-    // 2. Add the cellIds to the filter builder structure.
-    filterBuilder.insertMany(region.cell_ids());
+    // Keys without cells sort last, they are stored but never returned by a query.
+    uint32_t writeIndex = keyMinCells.size();
+    keyMinCells.push_back(coverStart < cells.size() ? cells[coverStart] : std::numeric_limits<uint64_t>::max());
 
-    // 3. Construct the set of cellIds per each region directly from the cellId vector;
-    const auto *regionPtr = reinterpret_cast<const uint64_t *>(region.data());
-    std::set < uint64_t > regionCoverSet(regionPtr, regionPtr + region.size());
-    keysToRegionCover.insert({key, std::move(regionCoverSet)});
+    // 2. A memory bounded build moves the cover to the cell runs, which spill once they pass the budget.
+    if (keySpill) {
+        keySpill->add(key);
+        for (auto cellId: std::span<const uint64_t>(cells).subspan(coverStart))
+            cellKeyRuns->add(cellId, writeIndex);
+        cells.clear();
+        return true;
+    }
+    keyArena.insert(keyArena.end(), key.begin(), key.end());
+    keyEnds.push_back(keyArena.size());
+    keyCellEnds.push_back(cells.size());
     return true;
 }
 
@@ -37,69 +178,140 @@ void reserve_header(FileWriteBuffer *f) {
 
 bool RoaringGeoMapWriter::build(const std::string &filePath) {
 
-    // 2. Iterate through the keys -> cells build up the map of cells ids -> key_ids. The key_id of a
-    // key is the uint32 index of the value when sorted in the keysToRegionCover vector. In theory, key_ids
-    // with near key_id values should represent data that is close spatially.
-    auto cellToKeyMap = std::make_unique<CellKeyIdsMap>();
-    uint32_t index = 0;
-
-    for (auto keyToCover = keysToRegionCover.begin(); keyToCover != keysToRegionCover.end(); ++keyToCover, ++index) {
-        auto regionCover = (*keyToCover).second;
-        for (auto cellId: regionCover) {
-            // Note, the index is now the uint32 id of the key
-            auto cellKeyIdsIt = cellToKeyMap->find(cellId);
-            if (cellKeyIdsIt != cellToKeyMap->end()) {
-                cellKeyIdsIt->second->add(index);
-            } else {
-                auto keyIdBitMap = std::make_unique<roaring::Roaring>();
-                keyIdBitMap->add(index);
-                cellToKeyMap->emplace(cellId, std::move(keyIdBitMap));
-            }
-        }
+    // 1. Order the keys by the smallest cell of their cover, the key_id of a key is its position in that order so
+    // key_ids with near values represent data that is close spatially. The sort is stable, keys sharing a smallest
+    // cell keep their write order.
+    uint32_t keyCount = keyMinCells.size();
+    std::vector<KeyOrder> keyOrder(keyCount);
+    for (uint32_t i = 0; i < keyCount; ++i)
+        keyOrder[i] = {keyMinCells[i], i};
+    std::vector<KeyOrder> keyOrderScratch;
+    radixSort(keyOrder, keyOrderScratch, [](const KeyOrder &k) { return k.minCell; });
+    keyOrderScratch = {};
+
+    std::unique_ptr<QueryExecutor> executor;
+    if (options.buildThreads > 1)
+        executor = std::make_unique<QueryExecutor>(options.buildThreads - 1);
+    size_t taskCount = executor ? executor->concurrency() * BUILD_TASKS_PER_THREAD : 1;
+
+    // 2. Group the (cellId, key_id) pairs by cell and build the bitmap of key_ids of each unique cell. A memory bounded
+    // build only collects the unique cells here and builds the bitmaps while merging the runs again to write them.
+    std::vector<CellPartition> partitions;
+    std::vector<uint32_t> keyIds;
+    std::vector<uint64_t> uniqueCells;
+    if (cellKeyRuns) {
+        keyIds.resize(keyCount);
+        for (uint32_t keyId = 0; keyId < keyCount; ++keyId)
+            keyIds[keyOrder[keyId].writeIndex] = keyId;
+        keyOrder = {};
+        cellKeyRuns->merge([&](uint64_t cellId, std::vector<uint32_t> &) { uniqueCells.push_back(cellId); });
+    } else {
+        partitions = buildPartitions(keyOrder, cells, keyCellEnds, executor.get(), taskCount);
+        for (const auto &partition: partitions)
+            uniqueCells.insert(uniqueCells.end(), partition.cells.begin(), partition.cells.end());
     }
 
+    // 3. Build the cell filter and the cell level bitmaps, both only need the unique cells.
+    CellFilter filter;
+    CellLevelBitmapsWriter cellLevelBitmaps;
+    forEachTask(executor.get(), 2, [&](size_t task) {
+        if (task == 0) {
+            CellFilter::Builder filterBuilder(options.cellFilterType);
+            filterBuilder.insertMany(std::span<const uint64_t>(uniqueCells));
+            filter = filterBuilder.build();
+        } else if (options.cellLevelBitmaps) {
+            cellLevelBitmaps.addCells(uniqueCells);
+        }
+    });
+
     Header header(levelIndexBucketRange, BLOCK_SIZE);
-    // 3. Create the file and reserve the header space by write space of header as 0'd out memory.
-    std::unique_ptr<FileWriteBuffer> f = std::make_unique<FileWriteBuffer>(filePath, 4096 * 4);
+    header.setBlockIndexLayout(options.blockIndexLayout);
+    header.setCellFilterType(options.cellFilterType);
+    // 4. Create the file and reserve the header space by write space of header as 0'd out memory.
+    std::unique_ptr<FileWriteBuffer> f = std::make_unique<FileWriteBuffer>(filePath);
     reserve_header(f.get());
 
-    // 4. Write s2 CellId filter
-    auto [pos, size] = filterBuilder.build().serialize(*f);
+    // 5. Write s2 CellId filter
+    auto [pos, size] = filter.serialize(*f);
     header.setCellIdFilterOffset(pos, size);
 
-    // 6. Write the key_id column to the roaring geomap, the keys position in the key_id column serves as it's index.
-    ByteColumnWriter keyColumn(BLOCK_SIZE);
-    for (const auto &keyToCover: keysToRegionCover) {
-        const std::string &key = keyToCover.first;
-        keyColumn.addBytes(std::vector<char>(key.begin(), key.end()));
+    // 6. Write the cell level bitmaps after the filter, both are read by every query.
+    if (options.cellLevelBitmaps) {
+        uint64_t cellLevelBitmapsOffset = f->offset();
+        uint64_t cellLevelBitmapsSize = cellLevelBitmaps.writeToFile(*f);
+        header.setCellLevelBitmapsOffset(cellLevelBitmapsOffset, cellLevelBitmapsSize);
     }
+
+    // 7. Write the key_id column to the roaring geomap, the keys position in the key_id column serves as it's index.
     // There is no index for the key's as they are indexed by their relative position in the column and thus the block
     // a key resides in can be inferred from the block size and number of entries in the column
     uint64_t keyIndexOffset = f->offset();
-    uint64_t keyIndexSize = keyColumn.writeToFile(*f);
+    uint64_t keyIndexSize;
+    if (keySpill) {
+        // The spilled keys are only readable during the callback, a block's keys are copied into buffers reused by
+        // every block until it is written.
+        ColumnStreamWriter<BytesBlockWriter, std::span<const char>> keyColumn(*f, BLOCK_SIZE, keyCount);
+        std::vector<std::vector<char>> blockKeys(BLOCK_SIZE);
+        size_t blockKeyCount = 0;
+        keySpill->forEachInKeyIdOrder(keyIds, [&](std::span<const char> key) {
+            auto &blockKey = blockKeys[blockKeyCount++];
+            blockKey.assign(key.begin(), key.end());
+            if (keyColumn.addValue(blockKey, key.size()))
+                blockKeyCount = 0;
+        });
+        keyIndexSize = keyColumn.finish();
+    } else {
+        // The key column views the keys in the arena, which outlives it.
+        ByteColumnWriter keyColumn(BLOCK_SIZE);
+        std::span<const char> keys(keyArena);
+        for (const auto &key: keyOrder) {
+            uint64_t keyStart = key.writeIndex == 0 ? 0 : keyEnds[key.writeIndex - 1];
+            keyColumn.addBytes(keys.subspan(keyStart, keyEnds[key.writeIndex] - keyStart));
+        }
+        keyIndexSize = keyColumn.writeToFile(*f);
+    }
     header.setKeyIndexOffset(keyIndexOffset, keyIndexSize);
-    header.setKeyIndexEntries(keysToRegionCover.size());
+    header.setKeyIndexEntries(keyCount);
 
     // Write the CellId to Key_Id section
-    CellIdColumnWriter cellIdColumn(BLOCK_SIZE);
-    RoaringBitmapColumnWriter bitmapColumn(BLOCK_SIZE);
-    for (const auto &[cellId, keyIdBitmap]: *cellToKeyMap) {
+    CellIdColumnWriter cellIdColumn(BLOCK_SIZE, options.blockIndexLayout);
+    for (auto cellId: uniqueCells)
         cellIdColumn.addValue(cellId);
-        bitmapColumn.addBitmap(&(*keyIdBitmap)); // TODO: compression ?
-    }
-
     uint64_t offset = f->offset();
     uint64_t cellIndexSize = cellIdColumn.writeToFile(*f);
     header.setCellIndexOffset(offset, cellIndexSize);
-    header.setCellIndexEntries(cellToKeyMap->size());
+    header.setCellIndexEntries(uniqueCells.size());
 
     offset = f->offset();
-    uint64_t bitmapSize = bitmapColumn.writeToFile(*f);
+    uint64_t bitmapSize;
+    if (cellKeyRuns) {
+        // Merge the runs again, each block of bitmaps is written as soon as it is complete.
+        ColumnStreamWriter<RoaringBitMapBlockWriter, roaring::Roaring *> bitmapColumn(*f, BLOCK_SIZE, uniqueCells.size());
+        std::vector<roaring::Roaring> blockBitmaps;
+        blockBitmaps.reserve(BLOCK_SIZE);
+        cellKeyRuns->merge([&](uint64_t, std::vector<uint32_t> &keys) {
+            for (auto &key: keys)
+                key = keyIds[key];
+            std::sort(keys.begin(), keys.end());
+            auto &bitmap = blockBitmaps.emplace_back();
+            bitmap.addMany(keys.size(), keys.data());
+            if (bitmapColumn.addValue(&bitmap, bitmap.getFrozenSizeInBytes()))
+                blockBitmaps.clear();
+        });
+        bitmapSize = bitmapColumn.finish();
+    } else {
+        RoaringBitmapColumnWriter bitmapColumn(BLOCK_SIZE);
+        for (auto &partition: partitions) {
+            for (auto &keyIdBitmap: partition.keyIdBitmaps)
+                bitmapColumn.addBitmap(&keyIdBitmap); // TODO: compression ?
+        }
+        bitmapSize = bitmapColumn.writeToFile(*f, executor.get());
+    }
     header.setBitmapOffset(offset, bitmapSize);
 
-    // Seek head of file buffer and write header
+    // Seek head of file buffer and write header, back-patched over the reserved space once the file is finalized.
     f->reset();
     header.writeToFile(*f);
-    f->flush(0);
+    f->finalize();
     return true;
 }
@@ -3,24 +3,39 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include "s2/s2region.h"
 #include "s2/s2cell_union.h"
 #include "roaring64map.hh"
 #include "CellFilter.h"
+#include "Header.h"
+#include "CellLevelBitmaps.h"
+#include "SpillFiles.h"
 
-inline bool
-compareBitMapMin(std::pair<std::string, roaring::Roaring64Map> a, std::pair<std::string, roaring::Roaring64Map> b) {
-    return a.second.minimum() < b.second.minimum();
-}
-
-using CellKeyIdsMap = std::map<uint64_t, std::unique_ptr<roaring::Roaring>>;
-using KeyCoverPair = std::pair<std::string, std::set<uint64_t>>;
-
-
-struct CompareKeyCoverPair {
-    bool operator()(const KeyCoverPair &a, const KeyCoverPair &b) const {
-        return *a.second.begin() < *b.second.begin();
-    }
+struct RoaringGeoMapWriterOptions {
+    // BTree writes a block index tree after the CellId blocks, which speeds up queries jumping between blocks of large
+    // indexes at the cost of about 1/7th of the block index in file size.
+    BlockIndexLayout blockIndexLayout = BlockIndexLayout::Sorted;
+    // EliasFano writes an exact cell filter probed directly on cell ids, larger than SuRF but without false positives
+    // or string conversions on each probe.
+    CellFilterType cellFilterType = CellFilterType::SuRF;
+    // Writes a bitmap of the cells present at each level, which answers the ancestor probes of queries exactly and
+    // without walking the cell filter.
+    bool cellLevelBitmaps = true;
+    // Threads used by build. Ranges of the cell id space have their bitmaps built concurrently and the bitmap blocks
+    // are serialized concurrently, the file written is the same for any number of threads.
+    unsigned buildThreads = 1;
+    // Once the pairs of cells and keys held by the writer pass this many bytes they are sorted and spilled to temp
+    // files, as are the keys, and build merges them back while writing the index, so indexes larger than memory can be
+    // built. The budget does not cover what the writer holds per key and per cell: 8 bytes per key while writing, 40
+    // bytes per key while build orders the keys (the smallest cell of each key, and the key order and its sort scratch),
+    // then 12 bytes per key, 4 more while the spilled keys are split into buckets by length, and 8 bytes per unique
+    // cell. The unique cells are copied too: 8 bytes per cell into the cell filter builder, which a SuRF filter turns
+    // into a string per cell, and 8 bytes per cell into the CellId column until it is written, next to the cell level
+    // bitmaps built from them. 0 builds in memory.
+    uint64_t buildMemoryBudget = 0;
+    // Directory of the temp files of a memory bounded build, the system temp directory when empty.
+    std::string buildTempDirectory;
 };
 
 // RoaringGeoMapWriter is responsible for writing geospatial data
@@ -31,6 +46,8 @@ class RoaringGeoMapWriter {
 public:
     RoaringGeoMapWriter(int levelIndexBucketRange);
 
+    RoaringGeoMapWriter(int levelIndexBucketRange, const RoaringGeoMapWriterOptions &options);
+
     // Writes the provided S2Region and associated bytes key.
     // If the description exceeds 512 characters, the method will return false.
     //
@@ -47,9 +64,18 @@ public:
 
 private:
     int levelIndexBucketRange;
-    CellFilter::Builder filterBuilder;
-    // TODO: We can use a regular hash set and then use a value to store the minimum value for sorting.
-    std::multiset<KeyCoverPair, CompareKeyCoverPair> keysToRegionCover;
+    RoaringGeoMapWriterOptions options;
+    // Keys and their covers are appended in write order to flat arrays and only sorted in build, the bytes of key i
+    // are keyArena[keyEnds[i - 1], keyEnds[i]) and its cells are cells[keyCellEnds[i - 1], keyCellEnds[i]).
+    std::vector<char> keyArena;
+    std::vector<uint64_t> keyEnds;
+    std::vector<uint64_t> cells;
+    std::vector<uint64_t> keyCellEnds;
+    // Smallest cell of each key's cover, keys are ordered by it to assign key ids.
+    std::vector<uint64_t> keyMinCells;
+    // Set when the build is memory bounded, the keys and their cells go to the spills instead of the flat arrays.
+    std::unique_ptr<CellKeyRuns> cellKeyRuns;
+    std::unique_ptr<KeySpill> keySpill;
 };
 
 #endif // ROARING_GEO_MAP_WRITER_H
\ No newline at end of file
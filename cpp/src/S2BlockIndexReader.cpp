@@ -1,11 +1,29 @@
 #include <S2BlockIndexReader.h>
 #include <cassert>
+#include <limits>
 
 S2BlockIndexReader::S2BlockIndexReader(FileReadBuffer &f, uint64_t pos, uint64_t size) : values(f, pos, size) {}
 
-std::vector<S2BlockValues<uint64_t>>
-S2BlockIndexReader::QueryValuesBlocks(std::set<std::pair<uint64_t, uint64_t>> &cellRanges,
-                                      std::set<uint64_t> &cellValues) {
+void S2BlockIndexReader::readTree(FileReadBuffer &f, uint64_t pos) {
+    tree.emplace(f, pos, values);
+}
+
+VectorView<uint64_t>::Iterator S2BlockIndexReader::seekBlock(VectorView<uint64_t>::Iterator from, uint64_t cellId) const {
+    if (!tree)
+        return gallopLowerBound(from, values.end(), cellId);
+    // Dense queries continue in the current or the next block, which are already in cache, check them before
+    // descending the tree.
+    if (from == values.end() || *from >= cellId)
+        return from;
+    if (from + 1 != values.end() && from[1] >= cellId)
+        return from + 1;
+    // Blocks before from end before cellId, so the tree's lower bound is never before from.
+    return values.begin() + tree->lowerBound(cellId);
+}
+
+void S2BlockIndexReader::QueryValuesBlocks(std::span<const std::pair<uint64_t, uint64_t>> cellRanges,
+                                           std::span<const uint64_t> cellValues,
+                                           std::vector<S2BlockValues<uint64_t>> &results) const {
 
     // This function assumes that cellValues is not over lapping with cell ranges. We make this assumption because this
     // function is only ever called with values derived from s2 region covers and the ancestors of any cell in the s2
@@ -15,56 +33,105 @@ S2BlockIndexReader::QueryValuesBlocks(std::set<std::pair<uint64_t, uint64_t>> &c
     assert(std::is_sorted(cellRanges.begin(), cellRanges.end()) && "query ranges must be sorted");
     assert(std::is_sorted(cellValues.begin(), cellValues.end()) && "query values must be sorted");
 
-    std::vector<S2BlockValues<uint64_t>> results;
-    // Search for which blocks contain values in the search range.
-    for (const auto &query: cellRanges) {
-        auto blockIndexRangeOption = findBlockRange(values, query);
-        if (blockIndexRangeOption == std::nullopt)
-            continue;
-
-        auto blockIndexRange = blockIndexRangeOption.value();
-        uint32_t startBlock = blockIndexRange.first;
-        uint32_t endBlock = blockIndexRange.second;
-
-        for (uint32_t blockId = startBlock; blockId <= endBlock; ++blockId) {
-            // Find the correct position to insert or update in results. We likely can assume that each value will be inserted
-            // in the end block or a block near it but to keep the code consistent will use binary search for now.
-            auto it = std::lower_bound(results.begin(), results.end(), blockId,
-                                       [](const S2BlockValues<uint64_t> &block, uint32_t id) {
-                                           return block.blockId < id;
-                                       });
-
-            if (it != results.end() && it->blockId == blockId) {
-                // Block ID exists; update it.
-                it->ranges.push_back(query);
-            } else {
-                // Block ID does not exist; insert a new entry at the correct position.
-                results.insert(it, S2BlockValues<uint64_t>{blockId, {query}, {}});
-            }
-        }
+    results.clear();
+    // Block i holds the cell ids in (values[i - 1], values[i]]. As the ranges are sorted and do not overlap, the ranges
+    // and values falling in a block are contiguous slices of the query, so each block's entry is a view of the query.
+    // The query and the block index are merged in one pass, each search gallops forward from where the previous one
+    // ended so dense queries step block by block and sparse queries skip over the blocks between them. When the index has
+    // a block index tree, jumps past the next block descend the tree instead.
+    size_t range = 0;
+    size_t value = 0;
+    auto blocksBegin = values.begin();
+    auto blockIt = values.begin();
+    // Smallest cell id not covered by the blocks planned so far.
+    uint64_t nextCellId = 0;
+    auto rangeStartsBefore = [](const std::pair<uint64_t, uint64_t> &cellRange, uint64_t cellId) {
+        return cellRange.first <= cellId;
+    };
+    auto valueBefore = [](uint64_t cellValue, uint64_t cellId) {
+        return cellValue <= cellId;
+    };
+    while (range < cellRanges.size() || value < cellValues.size()) {
+        uint64_t queryStart = std::numeric_limits<uint64_t>::max();
+        if (range < cellRanges.size())
+            queryStart = std::max(cellRanges[range].first, nextCellId);
+        if (value < cellValues.size())
+            queryStart = std::min(queryStart, cellValues[value]);
+
+        // The block the smallest remaining query starts in, queries past the last block are not in the index.
+        blockIt = seekBlock(blockIt, queryStart);
+        if (blockIt == values.end())
+            break;
+        auto blockId = static_cast<uint32_t>(std::distance(blocksBegin, blockIt));
+        uint64_t blockMax = *blockIt;
+
+        // The ranges starting and the values within the block.
+        auto rangesEnd = static_cast<size_t>(
+                gallopLowerBound(cellRanges.begin() + range, cellRanges.end(), blockMax, rangeStartsBefore) -
+                cellRanges.begin());
+        auto valuesEnd = static_cast<size_t>(
+                gallopLowerBound(cellValues.begin() + value, cellValues.end(), blockMax, valueBefore) -
+                cellValues.begin());
+
+        results.push_back({blockId, cellRanges.subspan(range, rangesEnd - range),
+                           cellValues.subspan(value, valuesEnd - value)});
+
+        // The last range of the block may continue into the following blocks.
+        bool rangeContinues = rangesEnd > range && cellRanges[rangesEnd - 1].second > blockMax;
+        range = rangeContinues ? rangesEnd - 1 : rangesEnd;
+        value = valuesEnd;
+        if (blockMax == std::numeric_limits<uint64_t>::max())
+            break;
+        nextCellId = blockMax + 1;
+        ++blockIt;
     }
+}
+
+void S2BlockIndexReader::ScanValuesBlocks(std::span<const std::pair<uint64_t, uint64_t>> cellRanges,
+                                          std::span<const uint64_t> cellValues,
+                                          std::vector<S2BlockValues<uint64_t>> &results) const {
+    assert(std::is_sorted(cellRanges.begin(), cellRanges.end()) && "query ranges must be sorted");
+    assert(std::is_sorted(cellValues.begin(), cellValues.end()) && "query values must be sorted");
 
-    // Search for which blocks contain values we search for.
-    for (uint64_t cellValue: cellValues) {
-        auto blockIdOption = findBlockValue(values, cellValue);
-        if (blockIdOption == std::nullopt)
-            continue;
-
-        auto blockId = blockIdOption.value();
-        // Find the correct position to insert or update in results.
-        auto it = std::lower_bound(results.begin(), results.end(), blockId,
-                                   [](const S2BlockValues<uint64_t> &block, uint32_t id) {
-                                       return block.blockId < id;
-                                   });
-
-        if (it != results.end() && it->blockId == blockId) {
-            // Block ID exists; update it.
-            it->values.push_back(cellValue);
-        } else {
-            // Block ID does not exist; insert a new entry at the correct position.
-            results.insert(it, S2BlockValues<uint64_t>{blockId, {}, {cellValue}});
+    results.clear();
+    if (cellRanges.empty() && cellValues.empty())
+        return;
+    uint64_t queryStart = std::numeric_limits<uint64_t>::max();
+    if (!cellRanges.empty())
+        queryStart = cellRanges.front().first;
+    if (!cellValues.empty())
+        queryStart = std::min(queryStart, cellValues.front());
+
+    // From the first block of the query every block is visited in turn, blocks no range or value falls in are skipped
+    // without being planned.
+    size_t range = 0;
+    size_t value = 0;
+    auto blocksBegin = values.begin();
+    for (auto blockIt = seekBlock(blocksBegin, queryStart);
+         blockIt != values.end() && (range < cellRanges.size() || value < cellValues.size()); ++blockIt) {
+        uint64_t blockMax = *blockIt;
+        size_t rangesEnd = range;
+        while (rangesEnd < cellRanges.size() && cellRanges[rangesEnd].first <= blockMax)
+            ++rangesEnd;
+        size_t valuesEnd = value;
+        while (valuesEnd < cellValues.size() && cellValues[valuesEnd] <= blockMax)
+            ++valuesEnd;
+
+        if (rangesEnd > range || valuesEnd > value) {
+            results.push_back({static_cast<uint32_t>(std::distance(blocksBegin, blockIt)),
+                               cellRanges.subspan(range, rangesEnd - range),
+                               cellValues.subspan(value, valuesEnd - value)});
         }
+
+        // The last range of the block may continue into the following blocks.
+        bool rangeContinues = rangesEnd > range && cellRanges[rangesEnd - 1].second > blockMax;
+        range = rangeContinues ? rangesEnd - 1 : rangesEnd;
+        value = valuesEnd;
+        if (blockMax == std::numeric_limits<uint64_t>::max())
+            break;
     }
+}
 
-    return results;
+uint32_t S2BlockIndexReader::FindBlock(uint64_t cellId) const {
+    return static_cast<uint32_t>(std::distance(values.begin(), seekBlock(values.begin(), cellId)));
 }
@@ -3,65 +3,84 @@
 #define ROARINGGEOMAPS_S2BLOCKINDEXREADER_H
 
 #include <cstdint>
-#include <set>
+#include <span>
 #include "WriteHelpers.h"  // Assuming this contains the write functions
 #include "io/FileReadBuffer.h"
 #include "unordered_set"
 #include "VectorView.h"
+#include "BlockIndexTree.h"
+#include <optional>
 #include <vector>
 #include <iostream>
 #include <algorithm>
 #include <cstdint>
 
+// S2BlockValues are the query ranges and values to search for in one block. They are views into the sorted query
+// ranges and values the plan was made from and must not outlive them.
 template<typename T>
 class S2BlockValues {
 public:
     uint32_t blockId;
-    std::vector<std::pair<T, T>> ranges;
-    std::vector<T> values;
+    std::span<const std::pair<T, T>> ranges;
+    std::span<const T> values;
 };
 
-// Binary search for matching prefix
-inline std::optional<std::pair<uint32_t, uint32_t>>
-findBlockRange(VectorView<uint64_t> &sortedValues, std::pair<uint64_t, uint64_t> cellRange) {
-
-    // Perform binary search to find the smallest child CellID that we are an ancestor of.
-    auto lowerIt = std::lower_bound(sortedValues.begin(), sortedValues.end(), cellRange.first);
-    if (lowerIt == sortedValues.end())
-        return std::nullopt;
-
-    auto upperIt = lowerIt;
-    while (upperIt != sortedValues.end() && *upperIt <= cellRange.second)
-        upperIt++;
-
-    // TODO: probably a more efficient way to do this but this involves the least amount evaluated statements;
-    if (upperIt == sortedValues.end())
-        upperIt--;
-
-    return std::pair<uint32_t, uint32_t>(std::distance(sortedValues.begin(), lowerIt),
-                                         std::distance(sortedValues.begin(), upperIt));
-}
-
-inline std::optional<uint32_t> findBlockValue(VectorView<uint64_t> &sortedValues, uint64_t cellId) {
-    // Perform binary search to find the smallest child  CellId that we are an ancestor of.
-    auto lowerIt = std::lower_bound(sortedValues.begin(), sortedValues.end(), cellId);
-    if (lowerIt == sortedValues.end()) {
-        return std::nullopt;
+// Returns the first position in [first, last) whose value is not less than value, like std::lower_bound, but probes
+// first + 1, first + 3, first + 7, ... before binary searching the last step. Searches starting near their result, as
+// in a merge of two sorted sequences, cost O(log distance) rather than O(log n).
+template<typename It, typename T, typename Compare>
+It gallopLowerBound(It first, It last, const T &value, Compare less) {
+    typename std::iterator_traits<It>::difference_type step = 1;
+    auto lo = first;
+    while (step < last - lo && less(lo[step - 1], value)) {
+        lo += step;
+        step *= 2;
     }
-    return std::distance(sortedValues.begin(), lowerIt);
+    return std::lower_bound(lo, lo + std::min(step, last - lo), value, less);
 }
 
+template<typename It, typename T>
+It gallopLowerBound(It first, It last, const T &value) {
+    return gallopLowerBound(first, last, value, std::less<>());
+}
 
 class S2BlockIndexReader {
 public:
     S2BlockIndexReader(FileReadBuffer &f, uint64_t pos, uint64_t size);
 
-    std::vector<S2BlockValues<uint64_t>>
-    QueryValuesBlocks(std::set<std::pair<uint64_t, uint64_t>> &ranges, std::set<uint64_t> &values);
+    // Plans the blocks to read for sorted, non overlapping ranges and sorted values. results is cleared and filled with
+    // one entry per block in block order, so a caller reusing it does not allocate once it has grown.
+    void QueryValuesBlocks(std::span<const std::pair<uint64_t, uint64_t>> ranges, std::span<const uint64_t> values,
+                           std::vector<S2BlockValues<uint64_t>> &results) const;
 
-    uint64_t sizeOf() { return sizeof(uint64_t) * values.size(); };
+    // Plans the same blocks as QueryValuesBlocks with a single search for the first block, then a linear merge of the
+    // query with the block index. Cheaper for queries touching most of the blocks between their first and last cell,
+    // where every search would land in the current or the next block.
+    void ScanValuesBlocks(std::span<const std::pair<uint64_t, uint64_t>> ranges, std::span<const uint64_t> values,
+                          std::vector<S2BlockValues<uint64_t>> &results) const;
+
+    // Index of the first block whose max is not less than cellId, the block cellId would be in, or BlockCount() when
+    // cellId is past the last block.
+    uint32_t FindBlock(uint64_t cellId) const;
+
+    uint32_t BlockCount() const { return static_cast<uint32_t>(values.size()); };
+
+    // Largest cell id of block blockId.
+    uint64_t BlockMax(uint32_t blockId) const { return values[blockId]; };
+
+    // Searches for the blocks of a query through the block index tree written at pos rather than galloping over the
+    // block index. The tree reads one cache line per layer, for indexes with many blocks this is far fewer cache
+    // misses than the probes of a binary search.
+    void readTree(FileReadBuffer &f, uint64_t pos);
+
+    // Size of the sorted block index in bytes, the tree is not included.
+    uint64_t sizeOf() const { return sizeof(uint64_t) * values.size(); };
 private:
     VectorView<uint64_t> values;
+    std::optional<BlockIndexTreeReader> tree;
+
+    // Returns the first block from from onwards whose max is not less than cellId.
+    VectorView<uint64_t>::Iterator seekBlock(VectorView<uint64_t>::Iterator from, uint64_t cellId) const;
 };
 
 
@@ -0,0 +1,230 @@
+#include "SearchKernels.h"
+#include "endian/endian.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ROARINGGEOMAPS_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Number of values left to the kernel's compares once the binary search narrows down the block. The windows are
+    // a few vectors wide, the binary search is cheaper than comparing more values than that.
+    const uint32_t WINDOW_SCALAR = 1;
+    const uint32_t WINDOW_SSE42 = 4;
+    const uint32_t WINDOW_AVX2 = 8;
+    const uint32_t WINDOW_AVX512 = 16;
+
+    inline uint64_t load(const char *values, uint32_t index) {
+        uint64_t value;
+        std::memcpy(&value, values + uint64_t(index) * sizeof(uint64_t), sizeof(uint64_t));
+        return littleEndian(value);
+    }
+
+    template<bool Inclusive>
+    uint32_t countScalar(const char *values, uint32_t count, uint64_t value) {
+        uint32_t result = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            result += Inclusive ? load(values, i) <= value : load(values, i) < value;
+        }
+        return result;
+    }
+
+#ifdef ROARINGGEOMAPS_X86_KERNELS
+    // SSE and AVX2 only compare signed 64 bit integers, flipping the sign bit of both sides orders unsigned values
+    // correctly. Values are loaded as is, x86 is little endian like the file. Inclusive counts are the values not
+    // greater than value.
+    template<bool Inclusive>
+    __attribute__((target("sse4.2,popcnt")))
+    uint32_t countSSE42(const char *values, uint32_t count, uint64_t value) {
+        const __m128i sign = _mm_set1_epi64x(INT64_MIN);
+        const __m128i query = _mm_xor_si128(_mm_set1_epi64x(static_cast<int64_t>(value)), sign);
+        uint32_t i = 0;
+        uint32_t matches = 0;
+        for (; i + 2 <= count; i += 2) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i * 8)), sign);
+            __m128i mask = Inclusive ? _mm_cmpgt_epi64(v, query) : _mm_cmpgt_epi64(query, v);
+            matches += std::popcount(static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(mask))));
+        }
+        uint32_t result = Inclusive ? i - matches : matches;
+        return result + countScalar<Inclusive>(values + i * 8, count - i, value);
+    }
+
+    template<bool Inclusive>
+    __attribute__((target("avx2,popcnt")))
+    uint32_t countAVX2(const char *values, uint32_t count, uint64_t value) {
+        const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+        const __m256i query = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(value)), sign);
+        uint32_t i = 0;
+        uint32_t matches = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i * 8)), sign);
+            __m256i mask = Inclusive ? _mm256_cmpgt_epi64(v, query) : _mm256_cmpgt_epi64(query, v);
+            matches += std::popcount(static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(mask))));
+        }
+        uint32_t result = Inclusive ? i - matches : matches;
+        return result + countScalar<Inclusive>(values + i * 8, count - i, value);
+    }
+
+    // AVX-512 compares unsigned integers directly and masks the tail of the window, lanes outside of the mask are not
+    // loaded.
+    template<bool Inclusive>
+    __attribute__((target("avx512f,popcnt")))
+    uint32_t countAVX512(const char *values, uint32_t count, uint64_t value) {
+        const __m512i query = _mm512_set1_epi64(static_cast<int64_t>(value));
+        uint32_t result = 0;
+        for (uint32_t i = 0; i < count; i += 8) {
+            auto lanes = static_cast<__mmask8>(count - i >= 8 ? 0xFF : (1u << (count - i)) - 1);
+            __m512i v = _mm512_maskz_loadu_epi64(lanes, values + i * 8);
+            __mmask8 mask = Inclusive ? _mm512_mask_cmple_epu64_mask(lanes, v, query)
+                                      : _mm512_mask_cmplt_epu64_mask(lanes, v, query);
+            result += std::popcount(static_cast<unsigned>(mask));
+        }
+        return result;
+    }
+#endif
+}
+
+SearchKernels::SearchKernels(SearchKernel type, uint32_t window, CountFunction countLess,
+                             CountFunction countLessEqual) :
+        type(type), window(window), countLess(countLess), countLessEqual(countLessEqual) {}
+
+const SearchKernels &SearchKernels::best() {
+    static const SearchKernels &kernels = [] () -> const SearchKernels & {
+        for (auto kernel: {SearchKernel::AVX512, SearchKernel::AVX2, SearchKernel::SSE42}) {
+            if (supported(kernel))
+                return get(kernel);
+        }
+        return get(SearchKernel::Scalar);
+    }();
+    return kernels;
+}
+
+const SearchKernels &SearchKernels::get(SearchKernel kernel) {
+    static const std::array<SearchKernels, 4> kernels = {
+            SearchKernels(SearchKernel::Scalar, WINDOW_SCALAR, countScalar<false>, countScalar<true>),
+#ifdef ROARINGGEOMAPS_X86_KERNELS
+            SearchKernels(SearchKernel::SSE42, WINDOW_SSE42, countSSE42<false>, countSSE42<true>),
+            SearchKernels(SearchKernel::AVX2, WINDOW_AVX2, countAVX2<false>, countAVX2<true>),
+            SearchKernels(SearchKernel::AVX512, WINDOW_AVX512, countAVX512<false>, countAVX512<true>),
+#else
+            SearchKernels(SearchKernel::SSE42, WINDOW_SCALAR, countScalar<false>, countScalar<true>),
+            SearchKernels(SearchKernel::AVX2, WINDOW_SCALAR, countScalar<false>, countScalar<true>),
+            SearchKernels(SearchKernel::AVX512, WINDOW_SCALAR, countScalar<false>, countScalar<true>),
+#endif
+    };
+    if (!supported(kernel)) {
+        throw std::invalid_argument(std::string("Search kernel not supported by this CPU: ") + name(kernel));
+    }
+    return kernels[static_cast<size_t>(kernel)];
+}
+
+bool SearchKernels::supported(SearchKernel kernel) {
+    switch (kernel) {
+        case SearchKernel::Scalar:
+            return true;
+#ifdef ROARINGGEOMAPS_X86_KERNELS
+        case SearchKernel::SSE42:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+        case SearchKernel::AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+        case SearchKernel::AVX512:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char *SearchKernels::name(SearchKernel kernel) {
+    switch (kernel) {
+        case SearchKernel::Scalar:
+            return "Scalar";
+        case SearchKernel::SSE42:
+            return "SSE4.2";
+        case SearchKernel::AVX2:
+            return "AVX2";
+        case SearchKernel::AVX512:
+            return "AVX-512";
+    }
+    return "Unknown";
+}
+
+template<bool Inclusive>
+uint32_t SearchKernels::bound(const char *values, uint32_t first, uint32_t last, uint64_t value) const {
+    // Branchless binary search down to a single window, the compare selects the next base without a branch to mispredict.
+    // Every value before base is before value and the bound is within [base, base + length].
+    uint32_t base = first;
+    uint32_t length = last - first;
+    while (length > window) {
+        uint32_t half = length / 2;
+        uint64_t middle = load(values, base + half - 1);
+        base = (Inclusive ? middle <= value : middle < value) ? base + half : base;
+        length -= half;
+    }
+
+    auto count = Inclusive ? countLessEqual : countLess;
+    return base + count(values + uint64_t(base) * sizeof(uint64_t), length, value);
+}
+
+uint32_t SearchKernels::lowerBound(const char *values, uint32_t first, uint32_t last, uint64_t value) const {
+    return bound<false>(values, first, last, value);
+}
+
+uint32_t SearchKernels::upperBound(const char *values, uint32_t first, uint32_t last, uint64_t value) const {
+    return bound<true>(values, first, last, value);
+}
+
+void SearchKernels::findValues(const char *values, uint32_t count, std::span<const uint64_t> queryValues,
+                               std::vector<uint32_t> &indexes) const {
+    indexes.clear();
+    uint32_t cursor = 0;
+    uint64_t previous = 0;
+    for (auto value: queryValues) {
+        // Out of order values are searched from the start of the block.
+        if (value < previous)
+            cursor = 0;
+        previous = value;
+
+        cursor = lowerBound(values, cursor, count, value);
+        // The cell filter can report values that are not in the index, only exact matches are returned.
+        if (cursor < count && load(values, cursor) == value) {
+            indexes.emplace_back(cursor);
+        }
+    }
+}
+
+void SearchKernels::findRanges(const char *values, uint32_t count,
+                               std::span<const std::pair<uint64_t, uint64_t>> queryRanges,
+                               std::vector<std::pair<uint32_t, uint32_t>> &indexRanges) const {
+    indexRanges.clear();
+    uint32_t cursor = 0;
+    uint64_t previous = 0;
+    for (const auto &range: queryRanges) {
+        if (range.first < previous)
+            cursor = 0;
+        previous = range.first;
+
+        uint32_t lower = lowerBound(values, cursor, count, range.first);
+        uint32_t upper = upperBound(values, lower, count, range.second);
+        cursor = lower;
+        if (lower >= upper)
+            continue;
+
+        // upper is exclusive so the inclusive end index is the value before it.
+        uint32_t endIndex = upper - 1;
+        if (!indexRanges.empty() && indexRanges.back().second >= lower) {
+            indexRanges.back().second = std::max(indexRanges.back().second, endIndex);
+        } else {
+            indexRanges.emplace_back(lower, endIndex);
+        }
+    }
+}
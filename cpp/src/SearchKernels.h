@@ -0,0 +1,73 @@
+#ifndef ROARINGGEOMAPS_SEARCHKERNELS_H
+#define ROARINGGEOMAPS_SEARCHKERNELS_H
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Instruction sets the search kernels are implemented with, from narrowest to widest.
+enum class SearchKernel : uint8_t {
+    Scalar,
+    SSE42,
+    AVX2,
+    AVX512
+};
+
+// SearchKernels searches a sorted array of little endian uint64 values in the read buffer, such as a CellId block. The
+// values do not need to be aligned. Every instruction set returns the same results, the kernels only differ in how the
+// final window of a search is compared. Searches of a batch start where the previous search ended.
+class SearchKernels {
+public:
+    // Kernels of the widest instruction set supported by the CPU, detected on first use.
+    static const SearchKernels &best();
+
+    // Kernels of a specific instruction set, kernel must be supported by the CPU.
+    static const SearchKernels &get(SearchKernel kernel);
+
+    static bool supported(SearchKernel kernel);
+
+    static const char *name(SearchKernel kernel);
+
+    SearchKernel kernel() const { return type; };
+
+    // Number of values[0, count) less than value, every value is compared. For a handful of values, e.g. a node of a
+    // search tree, this is the lower bound of value without any branches.
+    uint32_t countLessThan(const char *values, uint32_t count, uint64_t value) const {
+        return countLess(values, count, value);
+    };
+
+    // Index of the first of values[first, last) not less than value, or last when there is none.
+    uint32_t lowerBound(const char *values, uint32_t first, uint32_t last, uint64_t value) const;
+
+    // Index of the first of values[first, last) greater than value, or last when there is none.
+    uint32_t upperBound(const char *values, uint32_t first, uint32_t last, uint64_t value) const;
+
+    // Writes the index of each query value equal to one of values[0, count) to indexes, which is cleared first. Query
+    // values are expected in ascending order, each search then starts where the previous one ended.
+    void findValues(const char *values, uint32_t count, std::span<const uint64_t> queryValues,
+                    std::vector<uint32_t> &indexes) const;
+
+    // Writes the inclusive index range of values[0, count) within each query range to indexRanges, which is cleared
+    // first. Overlapping index ranges are merged, adjacent ones are kept apart. Query ranges are expected in ascending
+    // order.
+    void findRanges(const char *values, uint32_t count, std::span<const std::pair<uint64_t, uint64_t>> queryRanges,
+                    std::vector<std::pair<uint32_t, uint32_t>> &indexRanges) const;
+
+private:
+    // Counts the values of values[0, count) less than (or less than or equal to) value, count is at most window.
+    using CountFunction = uint32_t (*)(const char *values, uint32_t count, uint64_t value);
+
+    SearchKernels(SearchKernel type, uint32_t window, CountFunction countLess, CountFunction countLessEqual);
+
+    SearchKernel type;
+    // Searches narrow down to window values which are then counted with the kernel's compares.
+    uint32_t window;
+    CountFunction countLess;
+    CountFunction countLessEqual;
+
+    template<bool Inclusive>
+    uint32_t bound(const char *values, uint32_t first, uint32_t last, uint64_t value) const;
+};
+
+#endif //ROARINGGEOMAPS_SEARCHKERNELS_H
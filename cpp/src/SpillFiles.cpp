@@ -0,0 +1,362 @@
+#include "SpillFiles.h"
+#include "RadixSort.h"
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+    // Pairs are spilled packed, without the padding of CellKey.
+    const size_t RUN_RECORD_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
+    // Largest and smallest number of pairs buffered per run while spilling or merging runs.
+    const size_t RUN_RECORDS_PER_BUFFER = 1 << 14;
+    const size_t MIN_RUN_RECORDS_PER_BUFFER = 1 << 10;
+    // Pending pairs are sorted with a scratch copy, each pair needs room for two.
+    const uint64_t PENDING_BYTES_PER_PAIR = 2 * sizeof(CellKey);
+    // Memory of each key ordered in memory besides its bytes, its start and length.
+    const uint64_t ORDERED_KEY_OVERHEAD = 2 * sizeof(uint64_t);
+
+    // Pairs buffered per run when count runs share memoryBudget.
+    size_t runBufferRecords(uint64_t memoryBudget, size_t count) {
+        return std::clamp<uint64_t>(memoryBudget / count / RUN_RECORD_SIZE, MIN_RUN_RECORDS_PER_BUFFER,
+                                    RUN_RECORDS_PER_BUFFER);
+    }
+
+    // Stdio buffer of a temp file given its share of a memory budget.
+    size_t tempFileBufferSize(uint64_t share) {
+        return std::clamp<uint64_t>(share, MIN_TEMP_FILE_BUFFER_SIZE, TEMP_FILE_BUFFER_SIZE);
+    }
+
+    // RunWriter packs pairs into a buffer of bufferRecords pairs and appends it to a run each time it fills.
+    class RunWriter {
+    public:
+        RunWriter(TempFile &file, size_t bufferRecords) : file(file), buffer(bufferRecords * RUN_RECORD_SIZE) {}
+
+        void add(const CellKey &pair) {
+            std::memcpy(buffer.data() + size, &pair.cellId, sizeof(uint64_t));
+            std::memcpy(buffer.data() + size + sizeof(uint64_t), &pair.keyId, sizeof(uint32_t));
+            size += RUN_RECORD_SIZE;
+            if (size == buffer.size())
+                flush();
+        }
+
+        void flush() {
+            file.write(buffer.data(), size);
+            size = 0;
+        }
+
+    private:
+        TempFile &file;
+        std::vector<char> buffer;
+        size_t size = 0;
+    };
+
+    // RunReader reads the packed pairs of a run through a buffer of bufferRecords pairs.
+    class RunReader {
+    public:
+        RunReader(TempFile &file, size_t bufferRecords) : file(file), buffer(bufferRecords * RUN_RECORD_SIZE) {
+            file.rewind();
+        }
+
+        bool next(CellKey &pair) {
+            if (position == size) {
+                size = file.readSome(buffer.data(), buffer.size());
+                position = 0;
+                if (size == 0)
+                    return false;
+            }
+            std::memcpy(&pair.cellId, buffer.data() + position, sizeof(uint64_t));
+            std::memcpy(&pair.keyId, buffer.data() + position + sizeof(uint64_t), sizeof(uint32_t));
+            position += RUN_RECORD_SIZE;
+            return true;
+        }
+
+    private:
+        TempFile &file;
+        std::vector<char> buffer;
+        size_t position = 0;
+        size_t size = 0;
+    };
+
+    // Calls func on the pairs of runs in cellId order, each run is read through a buffer of bufferRecords pairs.
+    template<typename Func>
+    void mergeRuns(std::span<TempFile> runs, size_t bufferRecords, Func func) {
+        std::vector<RunReader> readers;
+        readers.reserve(runs.size());
+        using HeapEntry = std::pair<CellKey, size_t>;
+        auto greater = [](const HeapEntry &a, const HeapEntry &b) { return a.first.cellId > b.first.cellId; };
+        std::priority_queue<HeapEntry, std::vector<HeapEntry>, decltype(greater)> heap(greater);
+        for (size_t i = 0; i < runs.size(); ++i) {
+            CellKey pair{};
+            if (readers.emplace_back(runs[i], bufferRecords).next(pair))
+                heap.push({pair, i});
+        }
+        while (!heap.empty()) {
+            auto [pair, run] = heap.top();
+            heap.pop();
+            func(pair);
+            if (readers[run].next(pair))
+                heap.push({pair, run});
+        }
+    }
+
+    // Reads count keys from file and calls func on them in key_id order, keyIdOf(i) returns the key_id of the i-th key
+    // read and is called before its length and bytes are read.
+    template<typename KeyIdOf>
+    void orderKeys(TempFile &file, uint64_t firstKeyId, uint64_t count, KeyIdOf keyIdOf,
+                   const std::function<void(std::span<const char>)> &func) {
+        std::vector<char> arena;
+        std::vector<uint64_t> starts(count);
+        std::vector<uint32_t> lengths(count);
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t index = keyIdOf(i) - firstKeyId;
+            uint32_t length;
+            file.read(&length, sizeof(length));
+            starts[index] = arena.size();
+            lengths[index] = length;
+            arena.resize(arena.size() + length);
+            file.read(arena.data() + starts[index], length);
+        }
+        for (uint64_t i = 0; i < count; ++i)
+            func(std::span<const char>(arena.data() + starts[i], lengths[i]));
+    }
+}
+
+TempFile::TempFile(const std::string &directory, size_t bufferSize) {
+    std::string path = directory + "/roaring_geo_map_spill_XXXXXX";
+    int fd = ::mkstemp(path.data());
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create temp file in: " + directory);
+    }
+    ::unlink(path.c_str());
+    file = ::fdopen(fd, "w+b");
+    if (file == nullptr) {
+        ::close(fd);
+        throw std::runtime_error("Failed to open temp file in: " + directory);
+    }
+    if (bufferSize == 0) {
+        std::setvbuf(file, nullptr, _IONBF, 0);
+    } else {
+        buffer = std::make_unique<char[]>(bufferSize);
+        std::setvbuf(file, buffer.get(), _IOFBF, bufferSize);
+    }
+}
+
+TempFile::~TempFile() {
+    if (file != nullptr)
+        std::fclose(file);
+}
+
+TempFile::TempFile(TempFile &&other) noexcept: file(other.file), buffer(std::move(other.buffer)) {
+    other.file = nullptr;
+}
+
+TempFile &TempFile::operator=(TempFile &&other) noexcept {
+    if (this != &other) {
+        if (file != nullptr)
+            std::fclose(file);
+        file = other.file;
+        buffer = std::move(other.buffer);
+        other.file = nullptr;
+    }
+    return *this;
+}
+
+void TempFile::write(const void *data, size_t size) {
+    if (std::fwrite(data, 1, size, file) != size) {
+        throw std::runtime_error("Failed to write temp file");
+    }
+}
+
+void TempFile::read(void *data, size_t size) {
+    if (readSome(data, size) != size) {
+        throw std::runtime_error("Unexpected end of temp file");
+    }
+}
+
+size_t TempFile::readSome(void *data, size_t size) {
+    size_t read = std::fread(data, 1, size, file);
+    if (read < size && std::ferror(file)) {
+        throw std::runtime_error("Failed to read temp file");
+    }
+    return read;
+}
+
+void TempFile::skip(uint64_t size) {
+    if (std::fseek(file, static_cast<long>(size), SEEK_CUR) != 0) {
+        throw std::runtime_error("Failed to skip in temp file");
+    }
+}
+
+void TempFile::rewind() {
+    if (std::fflush(file) != 0 || std::fseek(file, 0, SEEK_SET) != 0) {
+        throw std::runtime_error("Failed to rewind temp file");
+    }
+}
+
+CellKeyRuns::CellKeyRuns(std::string directory, uint64_t memoryBudget) : directory(std::move(directory)),
+                                                                         memoryBudget(memoryBudget) {}
+
+void CellKeyRuns::add(uint64_t cellId, uint32_t key) {
+    pending.push_back({cellId, key});
+    pendingSorted = false;
+    if (pending.size() * PENDING_BYTES_PER_PAIR >= memoryBudget)
+        spill();
+}
+
+void CellKeyRuns::spill() {
+    std::vector<CellKey> scratch;
+    radixSort(pending, scratch, [](const CellKey &c) { return c.cellId; });
+    scratch = {};
+
+    // Runs are written and read through the buffers of RunWriter and RunReader, the pending pairs leave about half
+    // the budget to the buffer once the scratch is released.
+    TempFile &run = runs.emplace_back(directory, 0);
+    RunWriter writer(run, runBufferRecords(memoryBudget, 2));
+    for (const auto &pair: pending)
+        writer.add(pair);
+    writer.flush();
+    // Release the memory, pending would otherwise keep its capacity while the next run fills.
+    pending = {};
+}
+
+void CellKeyRuns::merge(const std::function<void(uint64_t, std::vector<uint32_t> &)> &func) {
+    std::vector<uint32_t> keys;
+    if (runs.empty()) {
+        // Everything fit the budget, the pairs are grouped in memory.
+        if (!pendingSorted) {
+            std::vector<CellKey> scratch;
+            radixSort(pending, scratch, [](const CellKey &c) { return c.cellId; });
+            pendingSorted = true;
+        }
+        for (size_t runStart = 0, runEnd; runStart < pending.size(); runStart = runEnd) {
+            keys.clear();
+            for (runEnd = runStart; runEnd < pending.size() && pending[runEnd].cellId == pending[runStart].cellId; ++runEnd)
+                keys.push_back(pending[runEnd].keyId);
+            func(pending[runStart].cellId, keys);
+        }
+        return;
+    }
+    if (!pending.empty())
+        spill();
+
+    // The budget is shared by the read buffers of the runs merged and the write buffer of the merged run. The oldest
+    // runs are merged into one until the rest can be merged at once, the runs left are kept for the next merge.
+    size_t fanIn = mergeFanIn();
+    while (runs.size() > fanIn) {
+        TempFile merged(directory, 0);
+        size_t bufferRecords = runBufferRecords(memoryBudget, fanIn + 1);
+        RunWriter writer(merged, bufferRecords);
+        mergeRuns(std::span<TempFile>(runs).first(fanIn), bufferRecords, [&](const CellKey &pair) { writer.add(pair); });
+        writer.flush();
+        runs.erase(runs.begin(), runs.begin() + static_cast<std::ptrdiff_t>(fanIn));
+        runs.push_back(std::move(merged));
+    }
+
+    uint64_t cellId = 0;
+    mergeRuns(runs, runBufferRecords(memoryBudget, runs.size()), [&](const CellKey &pair) {
+        if (!keys.empty() && pair.cellId != cellId) {
+            func(cellId, keys);
+            keys.clear();
+        }
+        cellId = pair.cellId;
+        keys.push_back(pair.keyId);
+    });
+    if (!keys.empty())
+        func(cellId, keys);
+}
+
+size_t CellKeyRuns::mergeFanIn() const {
+    // Each run merged and the merged run need a buffer of at least the smallest size.
+    return std::max<uint64_t>(3, memoryBudget / (MIN_RUN_RECORDS_PER_BUFFER * RUN_RECORD_SIZE)) - 1;
+}
+
+KeySpill::KeySpill(std::string directory, uint64_t memoryBudget)
+        : directory(std::move(directory)), memoryBudget(memoryBudget),
+          file(this->directory, tempFileBufferSize(memoryBudget / 16)) {}
+
+void KeySpill::add(std::string_view key) {
+    auto length = static_cast<uint32_t>(key.size());
+    file.write(&length, sizeof(length));
+    file.write(key.data(), key.size());
+    keyCount++;
+    keyBytes += key.size();
+}
+
+void KeySpill::forEachInKeyIdOrder(const std::vector<uint32_t> &keyIds,
+                                   const std::function<void(std::span<const char>)> &func) {
+    file.rewind();
+    uint64_t orderedBytes = keyBytes + keyCount * ORDERED_KEY_OVERHEAD;
+    if (orderedBytes <= memoryBudget) {
+        orderKeys(file, 0, keyCount, [&](uint64_t i) { return keyIds[i]; }, func);
+        return;
+    }
+
+    // Buckets are split by the bytes their keys take once ordered, so keys of skewed lengths do not push a bucket past
+    // half the budget. The lengths are gathered by key_id in a first pass over the file.
+    uint64_t halfBudget = std::max<uint64_t>(1, memoryBudget / 2);
+    std::vector<uint64_t> bucketStarts;
+    {
+        std::vector<uint32_t> lengths(keyCount);
+        for (uint64_t i = 0; i < keyCount; ++i) {
+            uint32_t length;
+            file.read(&length, sizeof(length));
+            file.skip(length);
+            lengths[keyIds[i]] = length;
+        }
+        uint64_t bucketBytes = 0;
+        for (uint64_t keyId = 0; keyId < keyCount; ++keyId) {
+            uint64_t keyOrderedBytes = lengths[keyId] + ORDERED_KEY_OVERHEAD;
+            if (bucketStarts.empty() || bucketBytes + keyOrderedBytes > halfBudget) {
+                bucketStarts.push_back(keyId);
+                bucketBytes = 0;
+            }
+            bucketBytes += keyOrderedBytes;
+        }
+        bucketStarts.push_back(keyCount);
+    }
+
+    uint64_t bucketCount = bucketStarts.size() - 1;
+    size_t bucketBufferSize = tempFileBufferSize(halfBudget / bucketCount);
+    uint64_t bucketsPerPass = std::max<uint64_t>(1, halfBudget / bucketBufferSize);
+    std::vector<char> key;
+    for (uint64_t passStart = 0; passStart < bucketCount; passStart += bucketsPerPass) {
+        // Distribute the keys of the pass into buckets of consecutive key_ids, each record is prefixed with its key_id.
+        uint64_t passEnd = std::min(bucketCount, passStart + bucketsPerPass);
+        std::vector<TempFile> buckets;
+        buckets.reserve(passEnd - passStart);
+        for (uint64_t b = passStart; b < passEnd; ++b)
+            buckets.emplace_back(directory, bucketBufferSize);
+        file.rewind();
+        for (uint64_t i = 0; i < keyCount; ++i) {
+            uint32_t length;
+            file.read(&length, sizeof(length));
+            uint32_t keyId = keyIds[i];
+            if (keyId < bucketStarts[passStart] || keyId >= bucketStarts[passEnd]) {
+                file.skip(length);
+                continue;
+            }
+            key.resize(length);
+            file.read(key.data(), length);
+            auto b = static_cast<uint64_t>(
+                    std::upper_bound(bucketStarts.begin(), bucketStarts.end(), keyId) - bucketStarts.begin()) - 1;
+            TempFile &bucket = buckets[b - passStart];
+            bucket.write(&keyId, sizeof(keyId));
+            bucket.write(&length, sizeof(length));
+            bucket.write(key.data(), length);
+        }
+
+        for (uint64_t b = passStart; b < passEnd; ++b) {
+            uint64_t firstKeyId = bucketStarts[b];
+            uint64_t count = bucketStarts[b + 1] - firstKeyId;
+            TempFile &bucket = buckets[b - passStart];
+            bucket.rewind();
+            orderKeys(bucket, firstKeyId, count, [&](uint64_t) {
+                uint32_t keyId;
+                bucket.read(&keyId, sizeof(keyId));
+                return keyId;
+            }, func);
+        }
+    }
+}
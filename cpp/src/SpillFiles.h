@@ -0,0 +1,113 @@
+#ifndef ROARINGGEOMAPS_SPILLFILES_H
+#define ROARINGGEOMAPS_SPILLFILES_H
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A cell id and a key, the key is the write index of the key while the writer spills pairs and its key_id once the
+// keys are ordered.
+struct CellKey {
+    uint64_t cellId;
+    uint32_t keyId;
+};
+
+// Largest and smallest bytes of stdio buffer of a temp file, files sized from a memory budget are in between.
+const size_t TEMP_FILE_BUFFER_SIZE = 1 << 18;
+const size_t MIN_TEMP_FILE_BUFFER_SIZE = 1 << 12;
+
+// TempFile is an anonymous file under directory, it is unlinked as soon as it is created so it is removed once closed,
+// even when the process does not exit cleanly. Files are written, rewound and then read back sequentially.
+class TempFile {
+public:
+    // A bufferSize of 0 leaves the file unbuffered, for owners reading and writing it in large chunks.
+    explicit TempFile(const std::string &directory, size_t bufferSize = TEMP_FILE_BUFFER_SIZE);
+
+    ~TempFile();
+
+    TempFile(TempFile &&other) noexcept;
+
+    TempFile &operator=(TempFile &&other) noexcept;
+
+    TempFile(const TempFile &) = delete;
+
+    TempFile &operator=(const TempFile &) = delete;
+
+    void write(const void *data, size_t size);
+
+    // Reads size bytes and throws if the file ends first.
+    void read(void *data, size_t size);
+
+    // Reads up to size bytes and returns the number of bytes read, 0 at the end of the file.
+    size_t readSome(void *data, size_t size);
+
+    // Moves past the next size bytes without reading them.
+    void skip(uint64_t size);
+
+    // Flushes pending writes and moves back to the start of the file.
+    void rewind();
+
+private:
+    std::FILE *file = nullptr;
+    // The stdio buffer is owned by the file, stdio would otherwise pick its own size.
+    std::unique_ptr<char[]> buffer;
+};
+
+// CellKeyRuns holds (cellId, key) pairs in memory until they pass memoryBudget bytes, then sorts them by cellId and
+// spills them as a run to a temp file. Merging reads the runs back in cellId order with a k-way merge, the read buffers
+// of the runs share memoryBudget so when there are more runs than fit it they are first merged into fewer runs.
+class CellKeyRuns {
+public:
+    CellKeyRuns(std::string directory, uint64_t memoryBudget);
+
+    void add(uint64_t cellId, uint32_t key);
+
+    // Calls func for every unique cell in cellId order with the keys added for it, in no particular order. The runs
+    // are kept so they can be merged more than once.
+    void merge(const std::function<void(uint64_t cellId, std::vector<uint32_t> &keys)> &func);
+
+    // Number of runs spilled so far, or left after the intermediate merges of merge.
+    size_t runCount() const { return runs.size(); };
+
+    // Most runs merged at once.
+    size_t mergeFanIn() const;
+
+private:
+    std::string directory;
+    uint64_t memoryBudget;
+    std::vector<CellKey> pending;
+    bool pendingSorted = false;
+    std::vector<TempFile> runs;
+
+    void spill();
+};
+
+// KeySpill appends keys in write order to a temp file and reads them back ordered by key_id. When the keys do not fit
+// memoryBudget they are first distributed into bucket temp files of consecutive key_ids, each small enough to be
+// ordered in half the budget, buckets are split by the bytes of their keys so only a key larger than that exceeds it.
+// The stdio buffers of the buckets share the other half, when there are too many buckets for their buffers to fit the
+// keys are distributed in several passes over the file, each filling a range of buckets.
+class KeySpill {
+public:
+    KeySpill(std::string directory, uint64_t memoryBudget);
+
+    void add(std::string_view key);
+
+    // Calls func with the bytes of every key in key_id order, keyIds holds the key_id of each key by write index.
+    void forEachInKeyIdOrder(const std::vector<uint32_t> &keyIds,
+                             const std::function<void(std::span<const char>)> &func);
+
+private:
+    std::string directory;
+    uint64_t memoryBudget;
+    TempFile file;
+    uint64_t keyCount = 0;
+    uint64_t keyBytes = 0;
+};
+
+#endif //ROARINGGEOMAPS_SPILLFILES_H
@@ -2,39 +2,47 @@
 #define ROARINGGEOMAPS_VECTORVIEW_H
 
 #include "io/FileReadBuffer.h"
+#include "endian/endian.h"
 #include <vector>
 #include <concepts>
 #include <cstdint>
+#include <cstring>
+#include <compare>
 #include <iterator>
 
 //// VectorView returns a vector like and iterator data structure over a section of the read buffer that contains a series of
 //// integrals. Data accessed through value operators is endian safe and does not preform any copies of the underlaying
-//// data.
+//// data, the view only holds a pointer into the read buffer and must not outlive it.
 template<std::integral T>
 class VectorView {
 public:
-    VectorView(FileReadBuffer &f, uint64_t pos, uint64_t size);
+    VectorView() = default;
+
+    VectorView(const FileReadBuffer &f, uint64_t pos, uint64_t size);
 
     // Iterator class
     class Iterator {
     public:
-        using iterator_category = std::forward_iterator_tag;
+        using iterator_category = std::random_access_iterator_tag;
+        using iterator_concept = std::random_access_iterator_tag;
         using difference_type = std::ptrdiff_t;
         using value_type = T;
-        using pointer = T;
+        using pointer = void;
         using reference = T;
 
-        // Constructor initializes pos_ as a pointer to the start of the range in `VectorView`
-        Iterator(VectorView *view, pointer pos) : pos_(pos), _view(view) {}
+        Iterator() = default;
+
+        // Constructor initializes pos_ as a pointer to the first byte of the current element.
+        explicit Iterator(const char *pos) : pos_(pos) {}
 
-        // Dereference operator returns a pointer to the element at the current position
-        pointer operator*() const { return (*_view)[pos_]; }
+        // Dereference operator returns the endian corrected value at the current position
+        reference operator*() const { return load(pos_); }
 
-        pointer operator->() const { return (*_view)[pos_]; }
+        reference operator[](difference_type n) const { return load(pos_ + n * difference_type(sizeof(T))); }
 
         // Pre-increment
         Iterator &operator++() {
-            ++pos_;
+            pos_ += sizeof(T);
             return *this;
         }
 
@@ -46,48 +54,77 @@ public:
         }
 
         Iterator &operator--() {
-            --pos_;
+            pos_ -= sizeof(T);
             return *this;
         }
 
-        // Post-increment
+        // Post-decrement
         Iterator operator--(int) {
             Iterator temp = *this;
             --(*this);
             return temp;
         }
 
-        bool operator==(const Iterator &other) const { return pos_ == other.pos_; }
+        Iterator &operator+=(difference_type n) {
+            pos_ += n * difference_type(sizeof(T));
+            return *this;
+        }
+
+        Iterator &operator-=(difference_type n) {
+            pos_ -= n * difference_type(sizeof(T));
+            return *this;
+        }
 
-        bool operator!=(const Iterator &other) const { return pos_ != other.pos_; }
+        friend Iterator operator+(Iterator it, difference_type n) { return it += n; }
 
-        bool operator<(const Iterator &other) const { return pos_ < other.pos_; }
+        friend Iterator operator+(difference_type n, Iterator it) { return it += n; }
+
+        friend Iterator operator-(Iterator it, difference_type n) { return it -= n; }
+
+        friend difference_type operator-(const Iterator &a, const Iterator &b) {
+            return (a.pos_ - b.pos_) / difference_type(sizeof(T));
+        }
+
+        bool operator==(const Iterator &other) const { return pos_ == other.pos_; }
+
+        auto operator<=>(const Iterator &other) const { return pos_ <=> other.pos_; }
 
     private:
-        pointer pos_;  // Pointer to the current element in `values`
-        VectorView *_view; //TODO: may want to use multi pointer for memory safety.
+        const char *pos_ = nullptr;  // Pointer to the current element in the read buffer
     };
 
-    Iterator begin() { return Iterator(this, 0); }
+    Iterator begin() const { return Iterator(values); }
 
-    Iterator end() { return Iterator(this, values.size()); }
+    Iterator end() const { return Iterator(values + length * sizeof(T)); }
 
     // Element access
-    T operator[](uint64_t i) { return littleEndian(values[i]); }
+    T operator[](uint64_t i) const { return load(values + i * sizeof(T)); }
+
+    uint64_t size() const { return length; };
 
-    const T operator[](uint64_t i) const { return littleEndian(values[i]); }
+    // Start of the little endian values in the read buffer, not necessarily aligned to sizeof(T).
+    const char *data() const { return values; };
 
-    uint64_t size() { return values.size(); };
+    bool empty() const { return length == 0; };
 
 private:
-    std::vector<T> values;
+    const char *values = nullptr;
+    uint64_t length = 0;
+
+    // Values in the file are not guaranteed to be aligned to sizeof(T), memcpy lets the compiler emit a plain
+    // (unaligned safe) load.
+    static T load(const char *pos) {
+        T value;
+        std::memcpy(&value, pos, sizeof(T));
+        return littleEndian(value);
+    }
 };
 
 template<std::integral T>
-VectorView<T>::VectorView(FileReadBuffer &f, uint64_t pos, uint64_t size) {
-    const auto *tPtr = reinterpret_cast<const T *>(f.view(pos, size * sizeof(T)));
-    values = std::vector<T>(tPtr, tPtr + size);
-}
+VectorView<T>::VectorView(const FileReadBuffer &f, uint64_t pos, uint64_t size) :
+        values(f.view(pos, size * sizeof(T))),
+        length(size) {}
 
-#endif //ROARINGGEOMAPS_VECTORVIEW_H
+static_assert(std::random_access_iterator<VectorView<uint64_t>::Iterator>);
 
+#endif //ROARINGGEOMAPS_VECTORVIEW_H
@@ -2,6 +2,7 @@
 #define ROARINGGEOMAPS_FUNCTIONS_H
 
 #include <cstdint>
+#include <cstring>
 #include <vector>
 #include "io/FileWriteBuffer.h"
 #include "endian/endian.h"
@@ -35,5 +36,13 @@ inline void writeLittleEndianUint64(FileWriteBuffer &buffer, uint64_t value) {
     buffer.write(reinterpret_cast<const char *>(&value), sizeof(value));
 }
 
+// Helper function to store a little-endian uint64 in memory about to be written, such as the buffer of a
+// FileWriteBuffer write func
+inline void storeLittleEndianUint64(char *data, uint64_t value) {
+    if constexpr (std::endian::native == std::endian::big) {
+        value = byteswap(value);
+    }
+    std::memcpy(data, &value, sizeof(value));
+}
 
 #endif // ROARINGGEOMAPS_FUNCTIONS_H
@@ -6,6 +6,8 @@
 #include <bit>
 #include <cstdint>
 #include <ranges>
+#include <array>
+#include <algorithm>
 
 // copy in byteswap from cpp 23 for now.
 template<std::integral T>
@@ -1,10 +1,65 @@
 #include "FileReadBuffer.h"
 #include <fstream>
 #include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+namespace {
+    int toMadvise(FileReadBuffer::Advice advice) {
+        switch (advice) {
+            case FileReadBuffer::Advice::Random:
+                return MADV_RANDOM;
+            case FileReadBuffer::Advice::Sequential:
+                return MADV_SEQUENTIAL;
+            case FileReadBuffer::Advice::WillNeed:
+                return MADV_WILLNEED;
+            case FileReadBuffer::Advice::DontNeed:
+                return MADV_DONTNEED;
+            default:
+                return MADV_NORMAL;
+        }
+    }
+
+    // Maps the entire file read only. The file descriptor is not needed once the mapping exists.
+    char *mapFile(const std::string &filename, uint64_t &fileSize) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open file: " + filename);
+        }
+
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat file: " + filename);
+        }
+        fileSize = st.st_size;
+        // mmap rejects zero length mappings, an empty file is left unmapped and fails on the first view.
+        if (fileSize == 0) {
+            ::close(fd);
+            return nullptr;
+        }
+
+        void *mapped = ::mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error("Failed to mmap file: " + filename + " (" + std::strerror(errno) + ")");
+        }
+        return static_cast<char *>(mapped);
+    }
+}
+
+// Simple buffer that either reads the entire index file into memory or memory maps it.
+FileReadBuffer::FileReadBuffer(const std::string &filename, Mode mode) : bufferMode(mode) {
+    if (mode == Mode::Mmap) {
+        buffer = mapFile(filename, buffer_size);
+        return;
+    }
 
-// Simple buffer that reads the entire index file into memory/
-FileReadBuffer::FileReadBuffer(const std::string &filename) {
     std::ifstream fileStream(filename, std::ios::binary | std::ios::ate);
     if (!fileStream) {
         throw std::runtime_error("Failed to open file: " + filename);
@@ -20,11 +75,17 @@ FileReadBuffer::FileReadBuffer(const std::string &filename) {
     }
 
     if (!fileStream.read(buffer, fileSize)) {
+        std::free(buffer);
         throw std::runtime_error("Failed to read file: " + filename);
     }
 }
 
 FileReadBuffer::~FileReadBuffer() {
+    if (bufferMode == Mode::Mmap) {
+        if (buffer != nullptr)
+            ::munmap(buffer, buffer_size);
+        return;
+    }
     std::free(buffer);
 }
 
@@ -43,3 +104,19 @@ const char *FileReadBuffer::view(uint64_t offset, uint64_t length) const {
     }
     return buffer + offset;
 }
+
+void FileReadBuffer::advise(uint64_t offset, uint64_t length, Advice advice) const {
+    if (bufferMode != Mode::Mmap || buffer == nullptr || length == 0 || offset >= buffer_size)
+        return;
+
+    // madvise requires a page aligned address, so widen the range down to the start of the page containing offset.
+    static const uint64_t pageSize = ::sysconf(_SC_PAGESIZE);
+    uint64_t alignedOffset = offset & ~(pageSize - 1);
+    uint64_t end = std::min(offset + length, buffer_size);
+    // Hints are best effort, a failure only means the kernel falls back to its default read ahead behaviour.
+    ::madvise(buffer + alignedOffset, end - alignedOffset, toMadvise(advice));
+}
+
+FileReadBuffer::Mode FileReadBuffer::mode() const {
+    return bufferMode;
+}
@@ -7,19 +7,46 @@
 
 class FileReadBuffer {
 public:
-    explicit FileReadBuffer(const std::string &filename);
+    // Heap copies the entire file into a private 32 byte aligned allocation on open. Mmap maps the file read only and
+    // shared, so open only costs the pages that are touched and processes reading the same index share one page cache
+    // copy of it.
+    enum class Mode {
+        Heap,
+        Mmap
+    };
+
+    // Access pattern hints for a section of the file, these are forwarded to madvise when the buffer is memory mapped
+    // and ignored otherwise.
+    enum class Advice {
+        Normal,
+        Random,
+        Sequential,
+        WillNeed,
+        DontNeed
+    };
+
+    explicit FileReadBuffer(const std::string &filename, Mode mode = Mode::Mmap);
 
     ~FileReadBuffer();
 
+    FileReadBuffer(const FileReadBuffer &) = delete;
+
+    FileReadBuffer &operator=(const FileReadBuffer &) = delete;
+
     const char *data() const;
 
     uint64_t size() const;
 
     const char *view(uint64_t offset, uint64_t length) const;
 
+    void advise(uint64_t offset, uint64_t length, Advice advice) const;
+
+    Mode mode() const;
+
 private:
-    char *buffer;
-    uint64_t buffer_size;
+    char *buffer = nullptr;
+    uint64_t buffer_size = 0;
+    Mode bufferMode;
 };
 
 #endif //ROARINGGEOMAPS_FILEREADBUFFER_H
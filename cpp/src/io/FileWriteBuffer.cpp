@@ -1,37 +1,42 @@
 // FileWriteBuffer.cpp
 
 #include "FileWriteBuffer.h"
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
-#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
 
 
-FileWriteBuffer::FileWriteBuffer(const std::string &filename, uint64_t initialSize) : filename(filename),
-                                                                                      buffer(initialSize),
-                                                                                      currentPos(0) {
-    fileStream.open(filename, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
-    if (!fileStream) {
+FileWriteBuffer::FileWriteBuffer(const std::string &filename, uint64_t chunkSize) : filename(filename),
+                                                                                    chunkSize(chunkSize) {
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
         throw std::runtime_error("Failed to open file: " + filename);
     }
+    buffer.reserve(chunkSize);
 }
 
 std::pair<uint64_t, uint64_t> FileWriteBuffer::write(const char *data, uint64_t size) {
     auto offset = currentPos;
-    if (offset + size > buffer.size()) {
-        buffer.resize(offset + size);
+    flushFullChunk();
+    if (offset == bufferStart + buffer.size() && size >= chunkSize) {
+        // Large values at the end of the file skip the buffer.
+        flushBuffer();
+        writeFile(offset, data, size);
+        bufferStart = offset + size;
+    } else {
+        put(offset, data, size);
     }
-    std::memcpy(buffer.data() + offset, data, size);
     currentPos = offset + size;
     return {offset, size};
 }
 
 std::pair<uint64_t, uint64_t> FileWriteBuffer::write(const std::function<void(char *)> &func, uint64_t size) {
     auto offset = currentPos;
-    if (offset + size > buffer.size()) {
-        buffer.resize(offset + size);
-    }
-    // invoke the writer func on the buffer, this allows us to use functions that directly
-    // write to a buffer instead of giving direct access to the buffer.
-    func(buffer.data() + offset);
+    flushFullChunk();
+    putWith(offset, func, size);
     currentPos = offset + size;
     return {offset, size};
 }
@@ -39,20 +44,38 @@ std::pair<uint64_t, uint64_t> FileWriteBuffer::write(const std::function<void(ch
 std::pair<uint64_t, uint64_t>
 FileWriteBuffer::write32ByteAligned(const std::function<void(char *)> &func, uint64_t size) {
     // find next set of bytes that is 32 byte aligned;
-    auto offset = (currentPos + 31) & ~31; // Find index that is 32 byte aligned.
-    if (offset + size > buffer.size()) {
-        buffer.resize(offset + size);
-    }
-    // invoke the writer func on the buffer, this allows us to use functions that directly
-    // write to a buffer instead of giving direct access to the buffer.
-    func(buffer.data() + offset);
+    writePadding(32);
+    return write(func, size);
+}
+
+std::pair<uint64_t, uint64_t> FileWriteBuffer::writePadding(uint64_t alignment) {
+    auto offset = currentPos;
+    auto size = ((offset + alignment - 1) / alignment) * alignment - offset;
+    flushFullChunk();
+    putWith(offset, [size](char *data) { std::memset(data, 0, size); }, size);
     currentPos = offset + size;
     return {offset, size};
 }
 
+std::pair<uint64_t, uint64_t> FileWriteBuffer::writeAt(uint64_t offset, const char *data, uint64_t size) {
+    if (offset + size > bufferStart + buffer.size()) {
+        throw std::runtime_error("writing beyond the reserved buffer");
+    }
+    put(offset, data, size);
+    return {offset, size};
+}
+
+std::pair<uint64_t, uint64_t>
+FileWriteBuffer::writeAt(uint64_t offset, const std::function<void(char *)> &func, uint64_t size) {
+    if (offset + size > bufferStart + buffer.size()) {
+        throw std::runtime_error("writing beyond the reserved buffer");
+    }
+    putWith(offset, func, size);
+    return {offset, size};
+}
 
 FileWriteBuffer::~FileWriteBuffer() {
-    fileStream.close();
+    ::close(fd);
 }
 
 void FileWriteBuffer::reset() {
@@ -60,29 +83,100 @@ void FileWriteBuffer::reset() {
 }
 
 void FileWriteBuffer::seek(uint64_t interval) {
-
-    if (currentPos + interval < 0) {
+    uint64_t position = currentPos + interval;
+    // Backward seeks are negative intervals wrapped around.
+    if ((interval >> 63) != 0 && position > currentPos) {
         throw std::runtime_error("seeking before start of buffer");
     }
-    if (currentPos + interval > buffer.size()) {
-        buffer.resize(currentPos + interval);
+    currentPos = position;
+    if (currentPos > bufferStart + buffer.size()) {
+        flushFullChunk();
+        buffered(bufferStart + buffer.size(), currentPos - bufferStart - buffer.size());
     }
-
-    currentPos += interval;
 }
 
 uint64_t FileWriteBuffer::size() const {
-    return buffer.size();
+    return bufferStart + buffer.size();
 }
 
 uint64_t FileWriteBuffer::offset() const {
     return currentPos;
 }
 
-void FileWriteBuffer::flush(uint64_t offset) {
-
-    fileStream.seekp(offset);
-    fileStream.write(buffer.data(), buffer.size());
-    fileStream.flush();
+void FileWriteBuffer::finalize() {
+    flushBuffer();
+    for (const auto &patch: patches) {
+        writeFile(patch.offset, patch.data.data(), patch.data.size());
+    }
+    patches.clear();
     currentPos = 0;
 }
+
+char *FileWriteBuffer::buffered(uint64_t offset, uint64_t size) {
+    uint64_t end = offset + size - bufferStart;
+    if (end > buffer.size()) {
+        buffer.resize(end);
+    }
+    return buffer.data() + (offset - bufferStart);
+}
+
+void FileWriteBuffer::put(uint64_t offset, const char *data, uint64_t size) {
+    if (offset < bufferStart) {
+        uint64_t patchSize = std::min(size, bufferStart - offset);
+        // Consecutive fields, such as those of the header, extend the last back-patch.
+        if (!patches.empty() && patches.back().offset + patches.back().data.size() == offset) {
+            patches.back().data.insert(patches.back().data.end(), data, data + patchSize);
+        } else {
+            patches.push_back({offset, std::vector<char>(data, data + patchSize)});
+        }
+        offset += patchSize;
+        data += patchSize;
+        size -= patchSize;
+    }
+    if (size > 0) {
+        std::memcpy(buffered(offset, size), data, size);
+    }
+}
+
+void FileWriteBuffer::putWith(uint64_t offset, const std::function<void(char *)> &func, uint64_t size) {
+    if (offset >= bufferStart) {
+        // invoke the writer func on the buffer, this allows us to use functions that directly
+        // write to a buffer instead of giving direct access to the buffer.
+        func(buffered(offset, size));
+    } else {
+        std::vector<char> data(size);
+        func(data.data());
+        put(offset, data.data(), size);
+    }
+}
+
+void FileWriteBuffer::flushFullChunk() {
+    if (buffer.size() >= chunkSize) {
+        flushBuffer();
+    }
+}
+
+void FileWriteBuffer::flushBuffer() {
+    writeFile(bufferStart, buffer.data(), buffer.size());
+    bufferStart += buffer.size();
+    buffer.clear();
+    // A large value may have grown the buffer well past a chunk.
+    if (buffer.capacity() > 2 * chunkSize) {
+        buffer.shrink_to_fit();
+        buffer.reserve(chunkSize);
+    }
+}
+
+void FileWriteBuffer::writeFile(uint64_t offset, const char *data, uint64_t size) {
+    while (size > 0) {
+        ssize_t written = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error("Failed to write file: " + filename);
+        }
+        offset += written;
+        data += written;
+        size -= written;
+    }
+}
@@ -1,34 +1,84 @@
 #ifndef ROARINGGEOMAPS_FILEWRITEBUFFER_H
 #define ROARINGGEOMAPS_FILEWRITEBUFFER_H
 
-#include <fstream>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
 #include <vector>
 
+// Bytes buffered before they are written to the file.
+const uint64_t WRITE_CHUNK_SIZE = 1 << 20;
+
+/*
+ * FileWriteBuffer streams a file out in chunks. Bytes are buffered from the first byte not yet written to the file and
+ * written with pwrite once chunkSize bytes are buffered, so memory stays about a chunk however large the file is.
+ * Seeking back and writing over bytes already written to the file, as writers do to fill in block offset tables and
+ * the header once the data after them is written, records the bytes as a back-patch that finalize applies.
+ */
 class FileWriteBuffer {
 public:
-    explicit FileWriteBuffer(const std::string &filename, uint64_t initialSize = 1024);
+    explicit FileWriteBuffer(const std::string &filename, uint64_t chunkSize = WRITE_CHUNK_SIZE);
 
     ~FileWriteBuffer();
 
+    FileWriteBuffer(const FileWriteBuffer &) = delete;
+
+    FileWriteBuffer &operator=(const FileWriteBuffer &) = delete;
+
     std::pair<uint64_t, uint64_t> write(const char *data, uint64_t size);
 
     std::pair<uint64_t, uint64_t> write(const std::function<void(char *)> &func, uint64_t size);
 
     std::pair<uint64_t, uint64_t> write32ByteAligned(const std::function<void(char *)> &func, uint64_t size);
 
-    void flush(uint64_t offset);  // Flushes any remaining data in the buffer to the file at position offset
-    void seek(uint64_t interval); // moves the buffer forward or backwards by pos
+    std::pair<uint64_t, uint64_t> writePadding(uint64_t alignment); // zero fills up to the next multiple of alignment
+
+    // Writes at offset without moving the write position. Within the bytes buffered since the last chunk was written,
+    // including space reserved by seeking past the end, nothing is resized or written to the file so writes to
+    // disjoint ranges may run from several threads at once. Writes before them are back-patches.
+    std::pair<uint64_t, uint64_t> writeAt(uint64_t offset, const char *data, uint64_t size);
+
+    std::pair<uint64_t, uint64_t> writeAt(uint64_t offset, const std::function<void(char *)> &func, uint64_t size);
+
+    // Writes the buffered bytes and the back-patches, the file is complete once it returns.
+    void finalize();
+
+    void seek(uint64_t interval); // moves the buffer forward or backwards by pos, moving past the end zero fills
     void reset();
 
     uint64_t offset() const; // current offset in the buffer that the next section of data will be written too
-    uint64_t size() const;
+    uint64_t size() const;   // size of the file written so far, including the buffered bytes
 
 private:
-    std::ofstream fileStream;  // File stream for writing
-    std::string filename;      // Filename of the file being written to
-    std::vector<char> buffer;
-    uint64_t currentPos;
+    struct Patch {
+        uint64_t offset;
+        std::vector<char> data;
+    };
+
+    int fd;
+    std::string filename;
+    uint64_t chunkSize;
+    std::vector<char> buffer;  // Bytes of the file from bufferStart on, not yet written to the file
+    uint64_t bufferStart = 0;
+    uint64_t currentPos = 0;
+    std::vector<Patch> patches;
+
+    // Returns the buffered bytes [offset, offset + size), extending the buffer with zeros, offset must be buffered.
+    char *buffered(uint64_t offset, uint64_t size);
+
+    // Copies size bytes to offset, into the buffer or into back-patches for the part before it.
+    void put(uint64_t offset, const char *data, uint64_t size);
+
+    // Calls func on the buffered bytes at offset, or on a copy put at offset when it is before the buffer.
+    void putWith(uint64_t offset, const std::function<void(char *)> &func, uint64_t size);
+
+    // Writes the buffer to the file once it holds a chunk.
+    void flushFullChunk();
+
+    void flushBuffer();
+
+    void writeFile(uint64_t offset, const char *data, uint64_t size);
 };
 
 #endif //ROARINGGEOMAPS_FILEWRITEBUFFER_H
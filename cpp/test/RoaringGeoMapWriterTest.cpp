@@ -4,8 +4,24 @@
 #include <s2/s2region_coverer.h>
 #include <s2/s2polygon.h>
 #include <s2/s2loop.h>
+#include <s2/s2cap.h>
+#include <set>
+#include <thread>
+#include <random>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <filesystem>
 #include "RoaringGeoMapWriter.h"
 #include "RoaringGeoMapReader.h"
+#include "SearchKernels.h"
+#include "io/FileWriteBuffer.h"
+#include "CellIdColumnWriter.h"
+#include "CellIdColumnReader.h"
+#include "RoaringBitmapColumnWriter.h"
+#include "QueryExecutor.h"
 
 
 TEST(RoaringGeoMapWriterTest, WriteSingleCellId) {
@@ -124,6 +140,1179 @@ TEST(RoaringGeoMapWriterTest, QueryNonExistentCellId) {
 }
 
 
+TEST(RoaringGeoMapWriterTest, QueryHeapAndMmapBuffers) {
+    // Arrange
+    RoaringGeoMapWriter writer(1);
+
+    S2LatLng latlng = S2LatLng::FromDegrees(37.7749, -122.4194); // San Francisco
+    S2CellId cellId(latlng.ToPoint());
+    S2CellUnion cellUnion;
+    cellUnion.Init({cellId});
+
+    writer.write(cellUnion, "buffered-id");
+    std::string testFilePath = "test_buffer_modes.roaring";
+    ASSERT_TRUE(writer.build(testFilePath));
+
+    // Query the same index through a heap copy and a memory mapped view of the file.
+    for (auto mode: {FileReadBuffer::Mode::Heap, FileReadBuffer::Mode::Mmap}) {
+        RoaringGeoMapReader reader(testFilePath, mode);
+        auto queryResults = reader.Contains(cellUnion);
+
+        // Assert
+        ASSERT_EQ(queryResults.size(), 1);
+        std::string resultsStr(queryResults[0].begin(), queryResults[0].end());
+        ASSERT_EQ(resultsStr, "buffered-id");
+    }
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, IntersectsCoverOutsideLevelBuckets) {
+    // Arrange, with a level bucket range of 3 the index levels are 3, 6, 9, 12 ...
+    RoaringGeoMapWriter writer(3);
+
+    S2LatLng latlng = S2LatLng::FromDegrees(37.7749, -122.4194); // San Francisco
+    S2CellId leaf(latlng.ToPoint());
+    S2CellUnion cellUnion;
+    cellUnion.Init({leaf.parent(10)});
+
+    writer.write(cellUnion, "level-10-id");
+    std::string testFilePath = "test_intersects.roaring";
+    ASSERT_TRUE(writer.build(testFilePath));
+
+    RoaringGeoMapReader reader(testFilePath);
+
+    // Query with a leaf cell inside the level 10 cell, its ancestor is not on a level Contains probes.
+    S2CellUnion leafUnion;
+    leafUnion.Init({leaf});
+    auto queryResults = reader.Intersects(leafUnion);
+    ASSERT_EQ(queryResults.size(), 1);
+    std::string resultsStr(queryResults[0].begin(), queryResults[0].end());
+    ASSERT_EQ(resultsStr, "level-10-id");
+
+    // Query with a cell containing the indexed cell.
+    S2CellUnion parentUnion;
+    parentUnion.Init({leaf.parent(5)});
+    ASSERT_EQ(reader.Intersects(parentUnion).size(), 1);
+
+    // Query with a cell next to the indexed cell.
+    S2CellUnion neighbourUnion;
+    neighbourUnion.Init({leaf.parent(10).next()});
+    ASSERT_EQ(reader.Intersects(neighbourUnion).size(), 0);
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, NearestOrderedByDistance) {
+    // Arrange, index points at increasing distance east of the query point.
+    RoaringGeoMapWriter writer(1);
+    S2LatLng origin = S2LatLng::FromDegrees(37.7749, -122.4194); // San Francisco
+
+    std::vector<std::pair<std::string, double>> keyOffsets = {
+            {"far-id",  1.0},
+            {"near-id", 0.0001},
+            {"mid-id",  0.01},
+    };
+    for (const auto &[key, lngOffset]: keyOffsets) {
+        S2CellUnion cellUnion;
+        cellUnion.Init({S2CellId(S2LatLng::FromDegrees(37.7749, -122.4194 + lngOffset).ToPoint())});
+        writer.write(cellUnion, key);
+    }
+    std::string testFilePath = "test_nearest.roaring";
+    ASSERT_TRUE(writer.build(testFilePath));
+
+    RoaringGeoMapReader reader(testFilePath);
+
+    // The two nearest keys are returned closest first.
+    auto queryResults = reader.Nearest(origin.ToPoint(), 2);
+    ASSERT_EQ(queryResults.size(), 2);
+    ASSERT_EQ(std::string(queryResults[0].begin(), queryResults[0].end()), "near-id");
+    ASSERT_EQ(std::string(queryResults[1].begin(), queryResults[1].end()), "mid-id");
+
+    // Keys further than the max distance are not returned, 0.01 degrees of longitude is ~900m at this latitude and
+    // 0.002 degrees is ~220m.
+    ASSERT_EQ(reader.Nearest(origin.ToPoint(), 3, S1Angle::Degrees(0.002)).size(), 1);
+    ASSERT_EQ(reader.Nearest(origin.ToPoint(), 3).size(), 3);
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, NearestSearchesTheOppositeFace) {
+    // Arrange, the only key is at the antipode of the query point, on the face opposite the point's face.
+    RoaringGeoMapWriter writer(1);
+    S2Point origin = S2LatLng::FromDegrees(37.7749, -122.4194).ToPoint(); // San Francisco
+    S2CellId antipode(-origin);
+    writer.write(S2CellUnion({antipode}), "antipode-id");
+    std::string testFilePath = "test_nearest_opposite_face.roaring";
+    ASSERT_TRUE(writer.build(testFilePath));
+
+    RoaringGeoMapReader reader(testFilePath);
+
+    // Act
+    auto queryResults = reader.Nearest(origin, 1);
+
+    // Assert
+    ASSERT_NE(antipode.face(), S2CellId(origin).face());
+    ASSERT_EQ(queryResults.size(), 1);
+    ASSERT_EQ(std::string(queryResults[0].begin(), queryResults[0].end()), "antipode-id");
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+// Builds an index at filePath of 50 keys key-0 .. key-49, key i covering the leaf cell i * 0.01 degrees north of San
+// Francisco, and returns the cells in cellIds.
+void buildKeysNorthOfSanFrancisco(const std::string &filePath, std::vector<S2CellId> &cellIds) {
+    RoaringGeoMapWriter writer(1);
+    for (int i = 0; i < 50; i++) {
+        S2CellId cellId(S2LatLng::FromDegrees(37.7749 + i * 0.01, -122.4194).ToPoint());
+        cellIds.push_back(cellId);
+        writer.write(S2CellUnion({cellId}), "key-" + std::to_string(i));
+    }
+    ASSERT_TRUE(writer.build(filePath));
+}
+
+TEST(RoaringGeoMapWriterTest, ContainsBatchMatchesContains) {
+    // Arrange
+    std::string testFilePath = "test_contains_batch.roaring";
+    std::vector<S2CellId> cellIds;
+    buildKeysNorthOfSanFrancisco(testFilePath, cellIds);
+
+    RoaringGeoMapReader reader(testFilePath);
+
+    // Overlapping queries hitting the same blocks, and a query matching nothing.
+    std::vector<S2CellUnion> queries(4);
+    queries[0].Init({cellIds[0].parent(8)});
+    queries[1].Init({cellIds[10], cellIds[20]});
+    queries[2].Init({cellIds[20].parent(12), cellIds[49]});
+    queries[3].Init({S2CellId(S2LatLng::FromDegrees(-45.0, 45.0).ToPoint())});
+
+    auto batchResults = reader.ContainsBatch(queries);
+
+    // Assert
+    ASSERT_EQ(batchResults.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); i++) {
+        ASSERT_EQ(batchResults[i], reader.Contains(queries[i])) << "query " << i;
+    }
+    ASSERT_TRUE(batchResults[3].empty());
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+// Builds an index at filePath of 2048 keys key-0 .. key-2047 on a diagonal from (37, -122), two full CellId blocks so
+// queries span block boundaries and the last block is full. Returns the cell of each key in cellIds and in query a
+// cover of most of the keys.
+void buildManyBlocksFile(const std::string &filePath, std::vector<S2CellId> &cellIds, S2CellUnion &query) {
+    RoaringGeoMapWriter writer(1);
+    for (int i = 0; i < 2048; i++) {
+        S2CellId cellId(S2LatLng::FromDegrees(37.0 + i * 0.0005, -122.0 + i * 0.0003).ToPoint());
+        cellIds.push_back(cellId);
+        writer.write(S2CellUnion({cellId}), "key-" + std::to_string(i));
+    }
+    ASSERT_TRUE(writer.build(filePath));
+
+    S2RegionCoverer::Options options;
+    options.set_max_cells(1000);
+    S2RegionCoverer coverer(options);
+    query = coverer.GetCovering(S2Cap(S2LatLng::FromDegrees(37.5, -121.7).ToPoint(), S1Angle::Degrees(0.4)));
+}
+
+TEST(RoaringGeoMapWriterTest, ContainsAcrossManyBlocks) {
+    // Arrange
+    std::string testFilePath = "test_many_blocks.roaring";
+    std::vector<S2CellId> cellIds;
+    S2CellUnion query;
+    buildManyBlocksFile(testFilePath, cellIds, query);
+
+    RoaringGeoMapReader reader(testFilePath);
+
+    std::set<std::string> expected;
+    for (size_t i = 0; i < cellIds.size(); i++) {
+        if (query.Contains(cellIds[i]))
+            expected.insert("key-" + std::to_string(i));
+    }
+
+    // Act
+    auto results = reader.Contains(query);
+
+    // Assert
+    std::set<std::string> found;
+    for (const auto &key: results)
+        found.emplace(key.begin(), key.end());
+    ASSERT_GT(expected.size(), 1024);
+    ASSERT_EQ(found, expected);
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, QueryResultsOrderedByKeyId) {
+    // Arrange, results spanning several key blocks.
+    std::string testFilePath = "test_query_results.roaring";
+    std::vector<S2CellId> cellIds;
+    S2CellUnion query;
+    buildManyBlocksFile(testFilePath, cellIds, query);
+
+    RoaringGeoMapReader reader(testFilePath);
+
+    // Act
+    auto results = reader.Contains(query);
+    auto nearest = reader.Nearest(cellIds[1000].ToPoint(), 1);
+
+    // Assert, results are ordered by key id and each key id reads back the same key.
+    ASSERT_GT(results.size(), 1024);
+    for (size_t i = 1; i < results.size(); i++) {
+        ASSERT_LT(results.keyId(i - 1), results.keyId(i));
+    }
+    ASSERT_EQ(nearest.size(), 1);
+    bool nearestFound = false;
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results.keyId(i) == nearest.keyId(0)) {
+            ASSERT_EQ(results[i], nearest[0]);
+            nearestFound = true;
+        }
+    }
+    ASSERT_TRUE(nearestFound);
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, ContainsCountAndKeyIdsMatchContains) {
+    // Arrange
+    std::string testFilePath = "test_contains_count.roaring";
+    std::vector<S2CellId> cellIds;
+    S2CellUnion query;
+    buildManyBlocksFile(testFilePath, cellIds, query);
+
+    RoaringGeoMapReader reader(testFilePath);
+
+    // Act
+    auto results = reader.Contains(query);
+    auto count = reader.ContainsCount(query);
+    auto keyIds = reader.ContainsKeyIds(query);
+
+    // Assert, the count and the key ids describe the same keys without reading them.
+    ASSERT_GT(results.size(), 1024);
+    ASSERT_EQ(count, results.size());
+    ASSERT_EQ(keyIds.cardinality(), results.size());
+    for (size_t i = 0; i < results.size(); i++) {
+        ASSERT_TRUE(keyIds.contains(results.keyId(i)));
+    }
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, ContainsCursorPagesThroughResults) {
+    // Arrange
+    std::string testFilePath = "test_contains_cursor.roaring";
+    std::vector<S2CellId> cellIds;
+    S2CellUnion query;
+    buildManyBlocksFile(testFilePath, cellIds, query);
+
+    RoaringGeoMapReader reader(testFilePath);
+
+    // Act
+    auto results = reader.Contains(query);
+    auto cursor = reader.ContainsCursor(query, 1000, 100);
+    auto pastEnd = reader.ContainsCursor(query, results.size());
+
+    // Assert, the cursor returns the page of the same keys in the same order and stops at its limit.
+    ASSERT_GT(results.size(), 1100);
+    ASSERT_EQ(cursor.totalCount(), results.size());
+    for (size_t i = 1000; i < 1100; i++) {
+        ASSERT_TRUE(cursor.next());
+        ASSERT_EQ(cursor.keyId(), results.keyId(i));
+        ASSERT_EQ(cursor.key(), results[i]);
+    }
+    ASSERT_FALSE(cursor.next());
+    ASSERT_FALSE(pastEnd.next());
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, ParallelContainsMatchesSerial) {
+    // Arrange
+    RoaringGeoMapWriter writer(1);
+
+    for (int i = 0; i < 5000; i++) {
+        S2CellId cellId(S2LatLng::FromDegrees(37.0 + i * 0.0002, -122.0 + i * 0.0002).ToPoint());
+        S2CellUnion cellUnion;
+        cellUnion.Init({cellId});
+        writer.write(cellUnion, "key-" + std::to_string(i));
+    }
+    std::string testFilePath = "test_parallel_contains.roaring";
+    ASSERT_TRUE(writer.build(testFilePath));
+
+    RoaringGeoMapReader serialReader(testFilePath);
+    RoaringGeoMapReaderOptions options;
+    options.executor = std::make_shared<QueryExecutor>(3);
+    options.parallelBlockThreshold = 2;
+    RoaringGeoMapReader parallelReader(testFilePath, options);
+
+    S2RegionCoverer::Options coverOptions;
+    coverOptions.set_max_cells(50);
+    S2RegionCoverer coverer(coverOptions);
+    S2CellUnion query = coverer.GetCovering(S2Cap(S2LatLng::FromDegrees(37.5, -121.5).ToPoint(), S1Angle::Degrees(2)));
+
+    // Act
+    auto expected = serialReader.Contains(query);
+    auto results = parallelReader.Contains(query);
+
+    // Assert, the query spans all 5 CellId blocks and is split across the executor.
+    ASSERT_EQ(expected.size(), 5000);
+    ASSERT_EQ(results, expected);
+    ASSERT_EQ(parallelReader.ContainsCount(query), expected.size());
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, SharedReaderConcurrentContains) {
+    // Arrange
+    RoaringGeoMapWriter writer(1);
+
+    for (int i = 0; i < 3000; i++) {
+        S2CellId cellId(S2LatLng::FromDegrees(37.0 + i * 0.0002, -122.0 + i * 0.0002).ToPoint());
+        S2CellUnion cellUnion;
+        cellUnion.Init({cellId});
+        writer.write(cellUnion, "key-" + std::to_string(i));
+    }
+    std::string testFilePath = "test_shared_reader.roaring";
+    ASSERT_TRUE(writer.build(testFilePath));
+
+    RoaringGeoMapReaderOptions options;
+    options.blockCacheBytes = 4096;
+    const RoaringGeoMapReader reader(testFilePath, options);
+
+    std::vector<S2CellUnion> queries;
+    for (int i = 0; i < 8; i++) {
+        S2RegionCoverer coverer;
+        queries.push_back(coverer.GetCovering(
+                S2Cap(S2LatLng::FromDegrees(37.0 + i * 0.08, -122.0 + i * 0.08).ToPoint(), S1Angle::Degrees(0.1))));
+    }
+    std::vector<QueryResults> expected;
+    for (const auto &query: queries)
+        expected.push_back(reader.Contains(query));
+
+    // Act, each thread runs every query against the shared reader with its own context while the small block cache
+    // evicts blocks under it.
+    std::vector<int> mismatches(4, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            QueryContext context;
+            for (int round = 0; round < 20; round++) {
+                for (size_t i = 0; i < queries.size(); i++) {
+                    if (!(reader.Contains(queries[(i + t) % queries.size()], context) ==
+                          expected[(i + t) % queries.size()]))
+                        mismatches[t]++;
+                }
+            }
+        });
+    }
+    for (auto &thread: threads)
+        thread.join();
+
+    // Assert
+    ASSERT_FALSE(expected.front().empty());
+    for (int t = 0; t < 4; t++)
+        ASSERT_EQ(mismatches[t], 0);
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, ContainsWithReusedContext) {
+    // Arrange
+    std::string testFilePath = "test_query_context.roaring";
+    std::vector<S2CellId> cellIds;
+    buildKeysNorthOfSanFrancisco(testFilePath, cellIds);
+
+    RoaringGeoMapReader reader(testFilePath);
+
+    std::vector<S2CellUnion> queries(3);
+    queries[0].Init({cellIds[0].parent(8)});
+    queries[1].Init({S2CellId(S2LatLng::FromDegrees(-45.0, 45.0).ToPoint())});
+    queries[2].Init({cellIds[10], cellIds[20].parent(12)});
+
+    // The keys of each query from the cells alone, every key is a leaf cell so a query finds the keys whose cell it
+    // contains.
+    std::vector<std::set<std::string>> expected(queries.size());
+    for (size_t i = 0; i < queries.size(); i++) {
+        for (size_t key = 0; key < cellIds.size(); key++) {
+            if (queries[i].Contains(cellIds[key]))
+                expected[i].insert("key-" + std::to_string(key));
+        }
+    }
+    ASSERT_EQ(expected[0].count("key-0"), 1);
+    ASSERT_TRUE(expected[1].empty());
+    ASSERT_EQ(expected[2].count("key-10"), 1);
+    ASSERT_EQ(expected[2].count("key-20"), 1);
+
+    // Act & Assert, a context is reused by every query and holds only the results of the last one, after an empty
+    // query and after queries with other results.
+    QueryContext context;
+    for (int round = 0; round < 2; round++) {
+        for (size_t i = 0; i < queries.size(); i++) {
+            const auto &results = reader.Contains(queries[i], context);
+            std::set<std::string> found;
+            for (size_t j = 0; j < results.size(); j++)
+                found.emplace(results[j]);
+            ASSERT_EQ(results.size(), expected[i].size()) << "query " << i;
+            ASSERT_EQ(found, expected[i]) << "query " << i;
+        }
+    }
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, BlockCacheHitsOnRepeatedQueries) {
+    // Arrange
+    std::string testFilePath = "test_block_cache.roaring";
+    std::vector<S2CellId> cellIds;
+    buildKeysNorthOfSanFrancisco(testFilePath, cellIds);
+
+    RoaringGeoMapReader cachedReader(testFilePath);
+    RoaringGeoMapReader uncachedReader(testFilePath, RoaringGeoMapReaderOptions{.blockCacheBytes = 0});
+
+    S2CellUnion query;
+    query.Init({cellIds[0].parent(8)});
+
+    // Act
+    auto first = cachedReader.Contains(query);
+    auto missesAfterFirst = cachedReader.BlockCacheStatistics().misses;
+    auto second = cachedReader.Contains(query);
+    auto stats = cachedReader.BlockCacheStatistics();
+
+    // Assert
+    ASSERT_FALSE(first.empty());
+    ASSERT_EQ(first, second);
+    ASSERT_EQ(first, uncachedReader.Contains(query));
+    ASSERT_GT(missesAfterFirst, 0);
+    ASSERT_EQ(stats.misses, missesAfterFirst);
+    ASSERT_EQ(stats.hits, missesAfterFirst);
+    ASSERT_LE(stats.sizeInBytes, stats.capacityInBytes);
+
+    auto uncachedStats = uncachedReader.BlockCacheStatistics();
+    ASSERT_EQ(uncachedStats.hits + uncachedStats.misses, 0);
+
+    // Clean up
+    std::remove(testFilePath.c_str());
+}
+
+// Writes keyCount keys key-0 .. key-<keyCount - 1>, key i covering the leaf cell at (30 + i * 0.001, -120 + i * 0.001),
+// so every key has its own cell and the cells run diagonally across many CellId blocks.
+void writeDiagonalKeys(RoaringGeoMapWriter &writer, int keyCount) {
+    for (int i = 0; i < keyCount; i++) {
+        S2CellId cellId(S2LatLng::FromDegrees(30.0 + i * 0.001, -120.0 + i * 0.001).ToPoint());
+        writer.write(S2CellUnion({cellId}), "key-" + std::to_string(i));
+    }
+}
+
+TEST(RoaringGeoMapWriterTest, BlockIndexTreeMatchesSortedBlockIndex) {
+    // Arrange, 12000 cells fill 12 CellId blocks so the tree has a layer above the block index.
+    RoaringGeoMapWriterOptions treeOptions;
+    treeOptions.blockIndexLayout = BlockIndexLayout::BTree;
+    RoaringGeoMapWriter sortedWriter(1);
+    RoaringGeoMapWriter treeWriter(1, treeOptions);
+
+    writeDiagonalKeys(sortedWriter, 12000);
+    writeDiagonalKeys(treeWriter, 12000);
+    std::string sortedFilePath = "test_sorted_block_index.roaring";
+    std::string treeFilePath = "test_block_index_tree.roaring";
+    ASSERT_TRUE(sortedWriter.build(sortedFilePath));
+    ASSERT_TRUE(treeWriter.build(treeFilePath));
+
+    RoaringGeoMapReader sortedReader(sortedFilePath);
+    RoaringGeoMapReader treeReader(treeFilePath);
+
+    for (int i = 0; i < 6; i++) {
+        S2RegionCoverer::Options coverOptions;
+        coverOptions.set_max_cells(20);
+        S2RegionCoverer coverer(coverOptions);
+        S2CellUnion query = coverer.GetCovering(
+                S2Cap(S2LatLng::FromDegrees(30.0 + i * 2.0, -120.0 + i * 2.0).ToPoint(), S1Angle::Degrees(0.5 + i)));
+
+        // Act
+        auto expected = sortedReader.Contains(query);
+        auto results = treeReader.Contains(query);
+
+        // Assert
+        ASSERT_FALSE(expected.empty());
+        ASSERT_EQ(results, expected);
+    }
+
+    // Clean up
+    std::remove(sortedFilePath.c_str());
+    std::remove(treeFilePath.c_str());
+}
+
+// Writes valueCount ascending values to a CellId column with each block index layout and checks the tree finds the
+// same blocks as the sorted block index, for every value and for a query whose values are several blocks apart.
+void expectBlockIndexTreeMatchesSortedBlockIndex(uint32_t valueCount, const std::string &filePath) {
+    std::vector<uint64_t> values;
+    for (uint64_t i = 0; i < valueCount; i++)
+        values.push_back(10 * i + 5);
+    uint64_t columnSizes[2];
+    {
+        FileWriteBuffer f(filePath);
+        for (auto layout: {BlockIndexLayout::Sorted, BlockIndexLayout::BTree}) {
+            CellIdColumnWriter column(1024, layout);
+            for (auto value: values)
+                column.addValue(value);
+            columnSizes[static_cast<int>(layout)] = column.writeToFile(f);
+        }
+        f.finalize();
+    }
+
+    FileReadBuffer f(filePath);
+    CellIdColumnReader sortedColumn(f, 0, columnSizes[0], valueCount, 1024, BlockIndexLayout::Sorted);
+    CellIdColumnReader treeColumn(f, columnSizes[0], columnSizes[1], valueCount, 1024, BlockIndexLayout::BTree);
+    const auto &sortedIndex = sortedColumn.BlockIndex();
+    const auto &treeIndex = treeColumn.BlockIndex();
+    ASSERT_EQ(treeIndex.BlockCount(), sortedIndex.BlockCount());
+    for (uint64_t cellId = 0; cellId < 10 * static_cast<uint64_t>(valueCount) + 20; cellId += 3) {
+        ASSERT_EQ(treeIndex.FindBlock(cellId), sortedIndex.FindBlock(cellId));
+    }
+
+    // Each value of the query is more than one block past the previous one, so the planner descends the tree.
+    std::vector<uint64_t> queryValues;
+    for (uint64_t i = 0; i < valueCount; i += 3500)
+        queryValues.push_back(values[i]);
+    std::vector<std::pair<uint64_t, uint64_t>> queryRanges;
+    std::vector<S2BlockValues<uint64_t>> expected;
+    std::vector<S2BlockValues<uint64_t>> results;
+    sortedIndex.QueryValuesBlocks(queryRanges, queryValues, expected);
+    treeIndex.QueryValuesBlocks(queryRanges, queryValues, results);
+    ASSERT_EQ(expected.size(), queryValues.size());
+    ASSERT_EQ(results.size(), expected.size());
+    for (size_t i = 0; i < results.size(); i++) {
+        ASSERT_EQ(results[i].blockId, expected[i].blockId);
+        ASSERT_EQ(results[i].values.size(), 1u);
+        ASSERT_EQ(results[i].values[0], expected[i].values[0]);
+    }
+}
+
+TEST(RoaringGeoMapWriterTest, BlockIndexTreeFindsBlocksAhead) {
+    // Arrange, 12 blocks so the tree has a single layer above the block index.
+    std::string filePath = "test_block_index_tree_ahead.bin";
+
+    // Act and Assert
+    ASSERT_NO_FATAL_FAILURE(expectBlockIndexTreeMatchesSortedBlockIndex(12000, filePath));
+
+    // Clean up
+    std::remove(filePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, BlockIndexTreeWithSeveralLayers) {
+    // Arrange, 100 blocks are more than a root node's 64 leaves so the tree has two layers above the block index.
+    std::string filePath = "test_block_index_tree_layers.bin";
+
+    // Act and Assert
+    ASSERT_NO_FATAL_FAILURE(expectBlockIndexTreeMatchesSortedBlockIndex(102400, filePath));
+
+    // Clean up
+    std::remove(filePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, SearchKernelsMatchStdSearch) {
+    // Arrange, values around 0, the sign bit and the max value check the unsigned compares of every kernel.
+    std::mt19937_64 gen(7);
+    std::vector<uint64_t> values;
+    for (uint64_t i = 0; i < 1000; i++) {
+        values.push_back(i % 3 == 0 ? gen() : i % 3 == 1 ? (uint64_t(1) << 63) + i - 500 : i);
+    }
+    values.push_back(std::numeric_limits<uint64_t>::max());
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    // Values in the file are little endian and not necessarily aligned.
+    std::vector<char> block(values.size() * sizeof(uint64_t) + 1);
+    for (size_t i = 0; i < values.size(); i++) {
+        uint64_t value = littleEndian(values[i]);
+        std::memcpy(block.data() + 1 + i * sizeof(uint64_t), &value, sizeof(uint64_t));
+    }
+    auto count = static_cast<uint32_t>(values.size());
+
+    std::vector<uint64_t> queryValues;
+    for (int i = 0; i < 200; i++) {
+        queryValues.push_back(i % 2 == 0 ? values[gen() % values.size()] : gen());
+    }
+    queryValues.push_back(0);
+    std::sort(queryValues.begin(), queryValues.end());
+    queryValues.erase(std::unique(queryValues.begin(), queryValues.end()), queryValues.end());
+    std::vector<std::pair<uint64_t, uint64_t>> queryRanges;
+    for (size_t i = 0; i + 1 < queryValues.size(); i += 2) {
+        queryRanges.emplace_back(queryValues[i], queryValues[i + 1]);
+    }
+
+    std::vector<uint32_t> expectedIndexes;
+    for (auto value: queryValues) {
+        auto it = std::lower_bound(values.begin(), values.end(), value);
+        if (it != values.end() && *it == value)
+            expectedIndexes.push_back(static_cast<uint32_t>(it - values.begin()));
+    }
+    std::vector<std::pair<uint32_t, uint32_t>> expectedRanges;
+    for (const auto &range: queryRanges) {
+        auto lower = static_cast<uint32_t>(std::lower_bound(values.begin(), values.end(), range.first) - values.begin());
+        auto upper = static_cast<uint32_t>(std::upper_bound(values.begin(), values.end(), range.second) - values.begin());
+        if (lower < upper)
+            expectedRanges.emplace_back(lower, upper - 1);
+    }
+
+    for (auto kernel: {SearchKernel::Scalar, SearchKernel::SSE42, SearchKernel::AVX2, SearchKernel::AVX512}) {
+        if (!SearchKernels::supported(kernel))
+            continue;
+        const auto &search = SearchKernels::get(kernel);
+
+        // Act
+        std::vector<uint32_t> indexes;
+        search.findValues(block.data() + 1, count, queryValues, indexes);
+        std::vector<std::pair<uint32_t, uint32_t>> indexRanges;
+        search.findRanges(block.data() + 1, count, queryRanges, indexRanges);
+
+        // Assert
+        ASSERT_EQ(indexes, expectedIndexes) << SearchKernels::name(kernel);
+        ASSERT_EQ(indexRanges, expectedRanges) << SearchKernels::name(kernel);
+        for (auto value: queryValues) {
+            auto lower = std::lower_bound(values.begin(), values.end(), value) - values.begin();
+            auto upper = std::upper_bound(values.begin(), values.end(), value) - values.begin();
+            ASSERT_EQ(search.lowerBound(block.data() + 1, 0, count, value), static_cast<uint32_t>(lower));
+            ASSERT_EQ(search.upperBound(block.data() + 1, 0, count, value), static_cast<uint32_t>(upper));
+        }
+    }
+}
+
+TEST(RoaringGeoMapWriterTest, EliasFanoCellFilterIsExact) {
+    // Arrange
+    std::mt19937_64 gen(11);
+    std::set<uint64_t> cellIds;
+    std::vector<S2CellId> cells;
+    for (int i = 0; i < 5000; i++) {
+        S2CellId cellId = S2CellId(S2LatLng::FromDegrees(-60.0 + (gen() % 12000) * 0.01,
+                                                         -180.0 + (gen() % 36000) * 0.01).ToPoint()).parent(
+                static_cast<int>(3 + gen() % 25));
+        cells.push_back(cellId);
+        cellIds.insert(cellId.id());
+    }
+    CellFilter::Builder builder(CellFilterType::EliasFano);
+    builder.insertMany(cells);
+    CellFilter filter = builder.build();
+
+    std::vector<uint64_t> probes;
+    for (auto cellId: cellIds) {
+        probes.push_back(cellId);
+        probes.push_back(cellId + 2);
+    }
+    std::sort(probes.begin(), probes.end());
+    probes.erase(std::unique(probes.begin(), probes.end()), probes.end());
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    for (int i = 0; i < 500; i++) {
+        S2CellId cellId = S2CellId(S2LatLng::FromDegrees(-60.0 + (gen() % 12000) * 0.01,
+                                                         -180.0 + (gen() % 36000) * 0.01).ToPoint()).parent(
+                static_cast<int>(gen() % 12));
+        ranges.emplace_back(cellId.range_min().id(), cellId.range_max().id());
+    }
+    // Sorted ranges without overlaps, as a normalized cover gives them, continue each search from the previous one.
+    std::vector<std::pair<uint64_t, uint64_t>> sortedRanges(ranges);
+    std::sort(sortedRanges.begin(), sortedRanges.end());
+    std::erase_if(sortedRanges, [last = uint64_t(0), first = true](const auto &range) mutable {
+        bool overlaps = !first && range.first <= last;
+        if (!overlaps)
+            last = range.second;
+        first = false;
+        return overlaps;
+    });
+
+    // Act
+    std::vector<uint64_t> found;
+    filter.containsMany(probes, found);
+    std::vector<std::pair<uint64_t, uint64_t>> foundRanges;
+    filter.containsRangeMany(ranges, foundRanges);
+    std::vector<std::pair<uint64_t, uint64_t>> foundSortedRanges;
+    filter.containsRangeMany(sortedRanges, foundSortedRanges);
+
+    // Assert, unlike SuRF the filter has no false positives.
+    ASSERT_EQ(filter.type(), CellFilterType::EliasFano);
+    std::vector<uint64_t> expected;
+    for (auto probe: probes) {
+        ASSERT_EQ(filter.contains(probe), cellIds.count(probe) == 1);
+        if (cellIds.count(probe) == 1)
+            expected.push_back(probe);
+    }
+    ASSERT_EQ(found, expected);
+
+    std::vector<std::pair<uint64_t, uint64_t>> expectedRanges;
+    for (const auto &range: ranges) {
+        auto [min, max, contained] = filter.containsRange(range.first, range.second);
+        auto first = cellIds.lower_bound(range.first);
+        auto end = cellIds.upper_bound(range.second);
+        ASSERT_EQ(contained, first != end);
+        if (first != end) {
+            ASSERT_EQ(min, *first);
+            ASSERT_EQ(max, *std::prev(end));
+            expectedRanges.emplace_back(*first, *std::prev(end));
+        }
+    }
+    ASSERT_EQ(foundRanges, expectedRanges);
+
+    std::vector<std::pair<uint64_t, uint64_t>> expectedSortedRanges;
+    for (const auto &range: sortedRanges) {
+        auto first = cellIds.lower_bound(range.first);
+        auto end = cellIds.upper_bound(range.second);
+        if (first != end)
+            expectedSortedRanges.emplace_back(*first, *std::prev(end));
+    }
+    ASSERT_GT(expectedSortedRanges.size(), 1);
+    ASSERT_EQ(foundSortedRanges, expectedSortedRanges);
+}
+
+TEST(RoaringGeoMapWriterTest, EliasFanoCellFilterMatchesSuRF) {
+    // Arrange
+    RoaringGeoMapWriterOptions eliasFanoOptions;
+    eliasFanoOptions.cellFilterType = CellFilterType::EliasFano;
+    RoaringGeoMapWriter surfWriter(3);
+    RoaringGeoMapWriter eliasFanoWriter(3, eliasFanoOptions);
+
+    for (int i = 0; i < 2000; i++) {
+        S2RegionCoverer::Options coverOptions;
+        coverOptions.set_max_cells(8);
+        S2RegionCoverer coverer(coverOptions);
+        S2CellUnion cellUnion = coverer.GetCovering(
+                S2Cap(S2LatLng::FromDegrees(30.0 + (i % 50) * 0.2, -120.0 + (i / 50) * 0.2).ToPoint(),
+                      S1Angle::Degrees(0.01 + (i % 7) * 0.02)));
+        surfWriter.write(cellUnion, "key-" + std::to_string(i));
+        eliasFanoWriter.write(cellUnion, "key-" + std::to_string(i));
+    }
+    std::string surfFilePath = "test_surf_cell_filter.roaring";
+    std::string eliasFanoFilePath = "test_elias_fano_cell_filter.roaring";
+    ASSERT_TRUE(surfWriter.build(surfFilePath));
+    ASSERT_TRUE(eliasFanoWriter.build(eliasFanoFilePath));
+
+    RoaringGeoMapReader surfReader(surfFilePath);
+    RoaringGeoMapReader eliasFanoReader(eliasFanoFilePath);
+
+    std::vector<S2CellUnion> queries;
+    for (int i = 0; i < 8; i++) {
+        S2RegionCoverer::Options coverOptions;
+        coverOptions.set_max_cells(20);
+        S2RegionCoverer coverer(coverOptions);
+        queries.push_back(coverer.GetCovering(
+                S2Cap(S2LatLng::FromDegrees(31.0 + i * 1.0, -119.0 + i * 0.5).ToPoint(), S1Angle::Degrees(0.1 + i * 0.1))));
+    }
+
+    // Act
+    auto expectedBatch = surfReader.ContainsBatch(queries);
+    auto batch = eliasFanoReader.ContainsBatch(queries);
+
+    // Assert
+    ASSERT_EQ(batch, expectedBatch);
+    for (const auto &query: queries) {
+        ASSERT_EQ(eliasFanoReader.Contains(query), surfReader.Contains(query));
+        ASSERT_EQ(eliasFanoReader.Intersects(query), surfReader.Intersects(query));
+    }
+    ASSERT_FALSE(surfReader.Contains(queries.back()).empty());
+
+    // Clean up
+    std::remove(surfFilePath.c_str());
+    std::remove(eliasFanoFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, CellLevelBitmapsMatchCellFilter) {
+    // Arrange, covers of different sizes write cells at many levels so queries find indexed ancestors.
+    RoaringGeoMapWriterOptions filterOnlyOptions;
+    filterOnlyOptions.cellLevelBitmaps = false;
+    RoaringGeoMapWriter filterOnlyWriter(1, filterOnlyOptions);
+    RoaringGeoMapWriter bitmapsWriter(1);
+
+    for (int i = 0; i < 500; i++) {
+        S2RegionCoverer::Options coverOptions;
+        coverOptions.set_max_cells(4 + i % 8);
+        S2RegionCoverer coverer(coverOptions);
+        S2CellUnion cellUnion = coverer.GetCovering(
+                S2Cap(S2LatLng::FromDegrees(40.0 + (i % 25) * 0.1, -100.0 + (i / 25) * 0.1).ToPoint(),
+                      S1Angle::Degrees(0.001 * (1 + i % 50))));
+        filterOnlyWriter.write(cellUnion, "key-" + std::to_string(i));
+        bitmapsWriter.write(cellUnion, "key-" + std::to_string(i));
+    }
+    std::string filterOnlyFilePath = "test_cell_filter_only.roaring";
+    std::string bitmapsFilePath = "test_cell_level_bitmaps.roaring";
+    ASSERT_TRUE(filterOnlyWriter.build(filterOnlyFilePath));
+    ASSERT_TRUE(bitmapsWriter.build(bitmapsFilePath));
+
+    RoaringGeoMapReader filterOnlyReader(filterOnlyFilePath);
+    RoaringGeoMapReader bitmapsReader(bitmapsFilePath);
+
+    std::vector<S2CellUnion> queries;
+    for (int i = 0; i < 10; i++) {
+        S2RegionCoverer::Options coverOptions;
+        coverOptions.set_max_cells(5 + i * 10);
+        coverOptions.set_max_level(S2CellId::kMaxLevel);
+        S2RegionCoverer coverer(coverOptions);
+        queries.push_back(coverer.GetCovering(
+                S2Cap(S2LatLng::FromDegrees(40.5 + i * 0.2, -99.5 + i * 0.1).ToPoint(), S1Angle::Degrees(0.0005 * (1 + i)))));
+    }
+
+    // Act
+    auto expectedBatch = filterOnlyReader.ContainsBatch(queries);
+    auto batch = bitmapsReader.ContainsBatch(queries);
+
+    // Assert
+    ASSERT_EQ(batch, expectedBatch);
+    bool found = false;
+    for (const auto &query: queries) {
+        auto expected = filterOnlyReader.Contains(query);
+        found |= !expected.empty();
+        ASSERT_EQ(bitmapsReader.Contains(query), expected);
+        ASSERT_EQ(bitmapsReader.Intersects(query), filterOnlyReader.Intersects(query));
+    }
+    ASSERT_TRUE(found);
+
+    // Clean up
+    std::remove(filterOnlyFilePath.c_str());
+    std::remove(bitmapsFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, QueryStrategiesMatch) {
+    // Arrange
+    RoaringGeoMapWriter writer(1);
+    writeDiagonalKeys(writer, 12000);
+    std::string filePath = "test_query_strategies.roaring";
+    ASSERT_TRUE(writer.build(filePath));
+
+    RoaringGeoMapReader reader(filePath);
+    std::vector<std::pair<QueryStrategy, std::unique_ptr<RoaringGeoMapReader>>> strategyReaders;
+    for (auto strategy: {QueryStrategy::FilterProbe, QueryStrategy::BlockIndex, QueryStrategy::Scan}) {
+        strategyReaders.emplace_back(strategy, std::make_unique<RoaringGeoMapReader>(
+                filePath, RoaringGeoMapReaderOptions{.queryStrategy = strategy}));
+    }
+
+    // A cover of every indexed cell and a single cell between two indexed cells.
+    S2RegionCoverer::Options denseOptions;
+    denseOptions.set_max_cells(500);
+    S2CellUnion dense = S2RegionCoverer(denseOptions).GetCovering(
+            S2Cap(S2LatLng::FromDegrees(36.0, -114.0).ToPoint(), S1Angle::Degrees(10)));
+    S2RegionCoverer::Options sparseOptions;
+    sparseOptions.set_max_cells(1);
+    S2CellUnion sparse = S2RegionCoverer(sparseOptions).GetCovering(
+            S2Cap(S2LatLng::FromDegrees(30.0105, -119.9895).ToPoint(), S1Angle::Degrees(0.00001)));
+
+    for (const auto &query: {dense, sparse}) {
+        // Act
+        auto expected = reader.Contains(query);
+
+        // Assert, every strategy finds the same keys.
+        for (const auto &[strategy, strategyReader]: strategyReaders) {
+            QueryContext context;
+            ASSERT_EQ(strategyReader->Contains(query, context), expected) << queryStrategyName(strategy);
+            ASSERT_EQ(context.plan().strategy, strategy);
+            ASSERT_FALSE(context.plan().costBased);
+        }
+    }
+
+    // The dense query reads every block whichever way it is planned, probing the filter first saves the sparse query
+    // from reading a block, short of a false positive.
+    ASSERT_EQ(reader.Contains(dense).size(), 12000u);
+    auto densePlan = reader.ExplainContains(dense);
+    ASSERT_TRUE(densePlan.costBased);
+    ASSERT_NE(densePlan.strategy, QueryStrategy::FilterProbe);
+    ASSERT_EQ(densePlan.blocksPlanned, 12u);
+    auto sparsePlan = reader.ExplainContains(sparse);
+    ASSERT_TRUE(sparsePlan.costBased);
+    ASSERT_EQ(sparsePlan.strategy, QueryStrategy::FilterProbe);
+    ASSERT_LE(sparsePlan.blocksPlanned, 1u);
+
+    // Clean up
+    std::remove(filePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, ContainsReportsQueryStats) {
+    // Arrange
+    RoaringGeoMapWriter writer(1);
+    writeDiagonalKeys(writer, 3000);
+    std::string filePath = "test_query_stats.roaring";
+    ASSERT_TRUE(writer.build(filePath));
+    RoaringGeoMapReader reader(filePath);
+
+    S2RegionCoverer::Options coverOptions;
+    coverOptions.set_max_cells(50);
+    S2CellUnion query = S2RegionCoverer(coverOptions).GetCovering(
+            S2Cap(S2LatLng::FromDegrees(31.0, -119.0).ToPoint(), S1Angle::Degrees(0.5)));
+
+    // Act
+    QueryStats stats;
+    auto results = reader.Contains(query, &stats);
+    QueryStats cachedStats;
+    auto cachedResults = reader.Contains(query, &cachedStats);
+
+    // Assert
+    ASSERT_FALSE(results.empty());
+    ASSERT_EQ(cachedResults, results);
+    ASSERT_EQ(results, reader.Contains(query));
+    ASSERT_GE(stats.queryCells, query.size());
+    ASSERT_GT(stats.filterProbes, 0u);
+    ASSERT_GT(stats.blocksPlanned, 0u);
+    ASSERT_GE(stats.cellIdEntriesScanned, stats.bitmapsRead);
+    ASSERT_EQ(stats.bitmapsRead, results.size());
+    ASSERT_EQ(stats.unionCardinality, results.size());
+    ASSERT_GT(stats.keyBlocksRead, 0u);
+    ASSERT_GT(stats.bytesTouched, 0u);
+    ASSERT_GT(stats.denormalizeNanos + stats.filterNanos + stats.planNanos + stats.blockProbeNanos + stats.unionNanos +
+              stats.keyFetchNanos, 0u);
+    // Bitmaps decoded by the first query are found in the block cache by the second.
+    ASSERT_EQ(stats.bitmapsDecoded, stats.bitmapsRead);
+    ASSERT_EQ(cachedStats.bitmapsDecoded, 0u);
+    ASSERT_EQ(cachedStats.bitmapsRead, stats.bitmapsRead);
+
+    // Clean up
+    std::remove(filePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, KeyIdsOrderedByMinimumCell) {
+    // Arrange, three adjacent leaf cells of one parent written by keys out of spatial order.
+    S2CellId parent = S2CellId(S2LatLng::FromDegrees(37.7749, -122.4194).ToPoint()).parent(20);
+    S2CellId a = parent.child_begin(S2CellId::kMaxLevel);
+    S2CellId b = a.next();
+    S2CellId c = b.next();
+
+    RoaringGeoMapWriter writer(1);
+    writer.write(S2CellUnion({c}), "k0");
+    writer.write(S2CellUnion({b, c}), "k1");
+    writer.write(S2CellUnion({a}), "k2");
+    writer.write(S2CellUnion({b}), "k3");
+    // Unsorted covers with repeated cells are indexed once per cell.
+    writer.write(S2CellUnion::FromVerbatim({c, a, a}), "k4");
+    std::string testFilePath = "test_key_id_order.roaring";
+    ASSERT_TRUE(writer.build(testFilePath));
+    RoaringGeoMapReader reader(testFilePath);
+
+    // Act
+    auto toStrings = [](const auto &results) {
+        std::vector<std::string> keys;
+        for (const auto &result: results)
+            keys.emplace_back(result.begin(), result.end());
+        return keys;
+    };
+    auto all = toStrings(reader.Contains(S2CellUnion({parent})));
+    auto shared = toStrings(reader.Contains(S2CellUnion({c})));
+
+    // Assert, keys are numbered by the smallest cell of their cover and keys sharing it keep their write order.
+    ASSERT_EQ(all, (std::vector<std::string>{"k2", "k4", "k1", "k3", "k0"}));
+    ASSERT_EQ(shared, (std::vector<std::string>{"k4", "k1", "k0"}));
+
+    std::remove(testFilePath.c_str());
+}
+
+// Returns the bytes of the file at path.
+std::string readFile(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Writes the same 5000 keys, each with a random cover of 1 to 8 small cells in the United States, to a writer with
+// each of the options and checks both build the same file byte for byte.
+void expectBuildsMatch(const RoaringGeoMapWriterOptions &options, const RoaringGeoMapWriterOptions &otherOptions,
+                       unsigned seed) {
+    RoaringGeoMapWriter writer(1, options);
+    RoaringGeoMapWriter otherWriter(1, otherOptions);
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<> lat_dist(24.0, 49.0);
+    std::uniform_real_distribution<> lng_dist(-125.0, -67.0);
+    for (int i = 0; i < 5000; i++) {
+        S2RegionCoverer::Options coverOptions;
+        coverOptions.set_max_cells(1 + i % 8);
+        S2RegionCoverer coverer(coverOptions);
+        S2CellUnion cellUnion = coverer.GetCovering(
+                S2Cap(S2LatLng::FromDegrees(lat_dist(gen), lng_dist(gen)).ToPoint(), S1Angle::Degrees(0.01)));
+        writer.write(cellUnion, "key-" + std::to_string(i));
+        otherWriter.write(cellUnion, "key-" + std::to_string(i));
+    }
+    std::string filePath = "test_build_" + std::to_string(seed) + ".roaring";
+    std::string otherFilePath = "test_other_build_" + std::to_string(seed) + ".roaring";
+
+    ASSERT_TRUE(writer.build(filePath));
+    ASSERT_TRUE(otherWriter.build(otherFilePath));
+    auto file = readFile(filePath);
+    ASSERT_FALSE(file.empty());
+    ASSERT_EQ(readFile(otherFilePath), file);
+
+    std::remove(filePath.c_str());
+    std::remove(otherFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, ParallelBuildMatchesSerialBuild) {
+    // Enough keys for many bitmap blocks and cell range partitions, the file written does not depend on the number of
+    // build threads.
+    RoaringGeoMapWriterOptions parallelOptions;
+    parallelOptions.buildThreads = 4;
+    expectBuildsMatch({}, parallelOptions, 7);
+}
+
+TEST(RoaringGeoMapWriterTest, ParallelBitmapColumnInBatchesMatchesSerial) {
+    // Arrange, bitmaps filling many small blocks and a batch size of a few blocks so the column is written in batches.
+    const uint64_t blockSize = 1024;
+    const uint64_t batchSize = 4 * blockSize;
+    std::mt19937 gen(13);
+    std::vector<roaring::Roaring> bitmaps(2000);
+    for (auto &bitmap: bitmaps) {
+        for (int i = 0, count = 1 + static_cast<int>(gen() % 40); i < count; i++)
+            bitmap.add(gen() % 100000);
+    }
+    std::string serialFilePath = "test_serial_bitmap_column.bin";
+    std::string parallelFilePath = "test_parallel_bitmap_column.bin";
+    QueryExecutor executor(3);
+
+    // Act
+    uint64_t serialSize;
+    uint64_t parallelSize;
+    {
+        RoaringBitmapColumnWriter column(blockSize);
+        for (auto &bitmap: bitmaps)
+            column.addBitmap(&bitmap);
+        FileWriteBuffer f(serialFilePath);
+        serialSize = column.writeToFile(f);
+        f.finalize();
+    }
+    {
+        RoaringBitmapColumnWriter column(blockSize);
+        for (auto &bitmap: bitmaps)
+            column.addBitmap(&bitmap);
+        FileWriteBuffer f(parallelFilePath);
+        parallelSize = column.writeToFile(f, &executor, batchSize);
+        f.finalize();
+    }
+
+    // Assert, the column spans several batches and is written the same as serially.
+    ASSERT_GT(serialSize, 8 * batchSize);
+    ASSERT_EQ(parallelSize, serialSize);
+    auto serialFile = readFile(serialFilePath);
+    ASSERT_EQ(serialFile.size(), serialSize);
+    ASSERT_EQ(readFile(parallelFilePath), serialFile);
+
+    std::remove(serialFilePath.c_str());
+    std::remove(parallelFilePath.c_str());
+}
+
+TEST(RoaringGeoMapWriterTest, MemoryBoundedBuildMatchesInMemoryBuild) {
+    // A budget small enough to spill many runs of cells and to distribute the keys into buckets, merging the spilled
+    // runs writes the same file as sorting in memory.
+    RoaringGeoMapWriterOptions boundedOptions;
+    boundedOptions.buildMemoryBudget = 1 << 16;
+    expectBuildsMatch({}, boundedOptions, 11);
+}
+
+TEST(RoaringGeoMapWriterTest, SpillsMergeAndOrderWithinBudget) {
+    // Arrange, a budget spilling far more runs than are merged at once and more key buckets than fit it at once.
+    const uint64_t memoryBudget = 1 << 15;
+    std::string directory = std::filesystem::temp_directory_path().string();
+    CellKeyRuns runs(directory, memoryBudget);
+    KeySpill keys(directory, memoryBudget);
+    std::mt19937_64 gen(17);
+    std::map<uint64_t, std::vector<uint32_t>> expected;
+    std::vector<std::string> keyBytes;
+    const uint32_t keyCount = 20000;
+    for (uint32_t key = 0; key < keyCount; key++) {
+        for (int i = 0, count = 1 + static_cast<int>(gen() % 4); i < count; i++) {
+            uint64_t cellId = gen() % 50000;
+            runs.add(cellId, key);
+            expected[cellId].push_back(key);
+        }
+        keyBytes.push_back("key-" + std::to_string(gen()));
+        keys.add(keyBytes.back());
+    }
+    std::vector<uint32_t> keyIds(keyCount);
+    std::iota(keyIds.begin(), keyIds.end(), 0);
+    std::shuffle(keyIds.begin(), keyIds.end(), gen);
+    ASSERT_GT(runs.runCount(), 2 * runs.mergeFanIn());
+
+    // Act, the runs are merged twice as the builder does.
+    std::map<uint64_t, std::vector<uint32_t>> merged;
+    runs.merge([&](uint64_t cellId, std::vector<uint32_t> &cellKeys) {
+        ASSERT_TRUE(merged.empty() || merged.rbegin()->first < cellId);
+        std::sort(cellKeys.begin(), cellKeys.end());
+        merged[cellId] = cellKeys;
+    });
+    size_t mergedAgain = 0;
+    runs.merge([&](uint64_t, std::vector<uint32_t> &) { mergedAgain++; });
+    std::vector<std::string> ordered;
+    keys.forEachInKeyIdOrder(keyIds, [&](std::span<const char> key) { ordered.emplace_back(key.begin(), key.end()); });
+
+    // Assert
+    for (auto &[cellId, cellKeys]: expected)
+        std::sort(cellKeys.begin(), cellKeys.end());
+    ASSERT_EQ(merged, expected);
+    ASSERT_LE(runs.runCount(), runs.mergeFanIn());
+    ASSERT_EQ(mergedAgain, expected.size());
+    ASSERT_EQ(ordered.size(), keyCount);
+    for (uint32_t i = 0; i < keyCount; i++)
+        ASSERT_EQ(ordered[keyIds[i]], keyBytes[i]);
+}
+
+TEST(RoaringGeoMapWriterTest, SpillOrdersKeysOfSkewedLengths) {
+    // Arrange, mostly short keys with a few long ones, some longer than half the budget alone.
+    const uint64_t memoryBudget = 1 << 14;
+    KeySpill keys(std::filesystem::temp_directory_path().string(), memoryBudget);
+    std::mt19937_64 gen(19);
+    std::vector<std::string> keyBytes;
+    const uint32_t keyCount = 5000;
+    for (uint32_t key = 0; key < keyCount; key++) {
+        size_t length = key % 500 == 0 ? memoryBudget : key % 50 == 0 ? 2000 : 8;
+        keyBytes.push_back(std::to_string(key) + std::string(length, static_cast<char>('a' + key % 26)));
+        keys.add(keyBytes.back());
+    }
+    std::vector<uint32_t> keyIds(keyCount);
+    std::iota(keyIds.begin(), keyIds.end(), 0);
+    std::shuffle(keyIds.begin(), keyIds.end(), gen);
+
+    // Act
+    std::vector<std::string> ordered;
+    keys.forEachInKeyIdOrder(keyIds, [&](std::span<const char> key) { ordered.emplace_back(key.begin(), key.end()); });
+
+    // Assert
+    ASSERT_EQ(ordered.size(), keyCount);
+    for (uint32_t i = 0; i < keyCount; i++)
+        ASSERT_EQ(ordered[keyIds[i]], keyBytes[i]);
+}
+
+TEST(RoaringGeoMapWriterTest, StreamedFileBackPatchesWrittenChunks) {
+    // Arrange, a chunk much smaller than the data so the reserved table and header are written before they are filled.
+    std::string filePath = "test_streamed_file.bin";
+    std::string expected(8 + 4 * sizeof(uint64_t), '\0');
+    {
+        FileWriteBuffer f(filePath, 64);
+
+        // Act, the header and a table of value end offsets are reserved and patched once the values are written.
+        f.seek(8);
+        f.seek(4 * sizeof(uint64_t));
+        std::vector<uint64_t> ends;
+        for (int i = 0; i < 4; i++) {
+            std::string value(100 + 50 * i, static_cast<char>('a' + i));
+            f.write(value.data(), value.size());
+            expected += value;
+            ends.push_back(f.offset());
+        }
+        f.seek(-1 * (f.offset() - 8));
+        f.write(reinterpret_cast<const char *>(ends.data()), ends.size() * sizeof(uint64_t));
+        std::memcpy(expected.data() + 8, ends.data(), ends.size() * sizeof(uint64_t));
+        f.reset();
+        f.write("HEADER!!", 8);
+        std::memcpy(expected.data(), "HEADER!!", 8);
+        f.finalize();
+    }
+
+    // Assert
+    ASSERT_EQ(readFile(filePath), expected);
+
+    std::remove(filePath.c_str());
+}
+
 // S2 test functions
 
 // Function to generate a random latitude and longitude within the United States
@@ -101,6 +101,53 @@ func (r *RoaringGeoMapReader) Contains(cellUnion s2.CellUnion) ([][]byte, error)
 	return cBytesToGo(bytesPtr, bytesSizePtr, size), nil
 }
 
+// Intersects returns the keys whose region cover intersects the provided S2CellUnion.
+func (r *RoaringGeoMapReader) Intersects(cellUnion s2.CellUnion) ([][]byte, error) {
+	cCellUnion := (*C.uint64_t)(unsafe.Pointer(&cellUnion[0]))
+	cSize := C.ulonglong(len(cellUnion))
+
+	var bytesPtr *C.char
+	var bytesSizePtr *C.ulonglong
+	var size C.ulonglong
+
+	if res := C.RoaringGeoMapReader_Intersects(r.reader, cCellUnion, cSize, &bytesPtr, &bytesSizePtr, &size); res != 0 {
+		return nil, errors.New("failed to query Intersects")
+	}
+	defer C.free(unsafe.Pointer(bytesPtr))
+	defer C.free(unsafe.Pointer(bytesSizePtr))
+
+	return cBytesToGo(bytesPtr, bytesSizePtr, size), nil
+}
+
+// ContainsCount returns the number of keys Contains would return without reading them.
+func (r *RoaringGeoMapReader) ContainsCount(cellUnion s2.CellUnion) (uint64, error) {
+	cCellUnion := (*C.uint64_t)(unsafe.Pointer(&cellUnion[0]))
+	cSize := C.ulonglong(len(cellUnion))
+
+	var count C.ulonglong
+	if res := C.RoaringGeoMapReader_ContainsCount(r.reader, cCellUnion, cSize, &count); res != 0 {
+		return 0, errors.New("failed to query ContainsCount")
+	}
+	return uint64(count), nil
+}
+
+// ContainsKeyIds returns the sorted ids of the keys Contains would return without reading the keys.
+func (r *RoaringGeoMapReader) ContainsKeyIds(cellUnion s2.CellUnion) ([]uint32, error) {
+	cCellUnion := (*C.uint64_t)(unsafe.Pointer(&cellUnion[0]))
+	cSize := C.ulonglong(len(cellUnion))
+
+	var keyIdsPtr *C.uint32_t
+	var size C.ulonglong
+	if res := C.RoaringGeoMapReader_ContainsKeyIds(r.reader, cCellUnion, cSize, &keyIdsPtr, &size); res != 0 {
+		return nil, errors.New("failed to query ContainsKeyIds")
+	}
+	defer C.free(unsafe.Pointer(keyIdsPtr))
+
+	keyIds := make([]uint32, int(size))
+	copy(keyIds, unsafe.Slice((*uint32)(unsafe.Pointer(keyIdsPtr)), int(size)))
+	return keyIds, nil
+}
+
 // Close cleans up the RoaringGeoMapReader.
 func (r *RoaringGeoMapReader) Close() {
 	if r.reader != nil {
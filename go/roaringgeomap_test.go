@@ -43,6 +43,22 @@ func TestRoaringGeoMapReader(t *testing.T) {
 	}
 
 	t.Logf("Contains results: %s", string(results[0]))
+
+	count, err := reader.ContainsCount(cellUnion)
+	if err != nil {
+		t.Fatalf("failed to query ContainsCount: %v", err)
+	}
+	if count != uint64(len(results)) {
+		t.Fatalf("ContainsCount returned %d, Contains returned %d keys", count, len(results))
+	}
+
+	keyIds, err := reader.ContainsKeyIds(cellUnion)
+	if err != nil {
+		t.Fatalf("failed to query ContainsKeyIds: %v", err)
+	}
+	if len(keyIds) != len(results) {
+		t.Fatalf("ContainsKeyIds returned %d ids, Contains returned %d keys", len(keyIds), len(results))
+	}
 }
 
 func randomLatLon() (float64, float64) {